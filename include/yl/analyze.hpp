@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+
+#include <yl/types.hpp>
+
+namespace yl {
+
+  // evaluates an analyzed expression in the given environment
+  using executor = ::std::function<result_type(env_node_ptr const&)>;
+
+  // does the dispatch of eval once, so that the returned executor only
+  // has to do the work that depends on the environment, in tail position
+  // calls of user defined functions are deferred instead of made
+  executor analyze(unit_ptr const& u, bool const tail = false) noexcept;
+
+  // call of a user defined function that is left to the function whose
+  // body it ends, see user_function
+  struct tail_call {
+    unit_ptr callee;
+    unit_ptr call;
+    env_node_ptr env;
+  };
+
+  // stores the call and returns the marker that stands in for its result
+  unit_ptr const& defer(tail_call call) noexcept;
+
+  bool is_deferred(unit_ptr const& u) noexcept;
+
+  tail_call take_deferred() noexcept;
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+
+#include <yl/types.hpp>
+
+namespace yl {
+
+  // stack that evaluators push the arguments of calls onto, a window never
+  // moves once pushed so spans into it stay valid while calls nest on top
+  class argument_stack {
+   public:
+    struct mark {
+      ::std::size_t chunk;
+      ::std::size_t used;
+    };
+
+    argument_stack() noexcept {
+      chunks.push_back(chunk{::std::make_unique<unit_ptr[]>(chunk_size), chunk_size, 0});
+    }
+
+    mark position() const noexcept {
+      return {current, chunks[current].used};
+    }
+
+    // count empty slots, released by popping to a mark taken before
+    unit_ptr* push(::std::size_t const count) noexcept {
+      auto* c = &chunks[current];
+      if (c->used + count > c->size) {
+        c = next(count);
+      }
+      auto* const first = c->values.get() + c->used;
+      c->used += count;
+      return first;
+    }
+
+    void pop(mark const& m) noexcept {
+      for (; current > m.chunk; --current) {
+        clear(chunks[current], 0);
+      }
+      clear(chunks[current], m.used);
+    }
+
+   private:
+    struct chunk {
+      ::std::unique_ptr<unit_ptr[]> values;
+      ::std::size_t size;
+      ::std::size_t used;
+    };
+
+    static constexpr ::std::size_t chunk_size = 1 << 12;
+
+    static void clear(chunk& c, ::std::size_t const used) noexcept {
+      for (auto i = used; i < c.used; ++i) {
+        c.values[i].reset();
+      }
+      c.used = used;
+    }
+
+    chunk* next(::std::size_t const count) noexcept {
+      ++current;
+      if (current == chunks.size()) {
+        chunks.push_back(chunk{});
+      }
+      auto& c = chunks[current];
+      if (c.size < count) {
+        auto const size = ::std::max(chunk_size, count);
+        c.values = ::std::make_unique<unit_ptr[]>(size);
+        c.size = size;
+      }
+      return &c;
+    }
+
+    seq_representation<chunk> chunks = make_seq<chunk>();
+    ::std::size_t current = 0;
+  };
+
+  inline argument_stack& arguments() noexcept {
+    static argument_stack stack;
+    return stack;
+  }
+
+  // arguments of one call, popped when it goes out of scope
+  class argument_window {
+   public:
+    explicit argument_window(::std::size_t const count) noexcept
+      : saved{arguments().position()}, first{arguments().push(count)} {}
+
+    argument_window(argument_window const&) = delete;
+    argument_window& operator=(argument_window const&) = delete;
+
+    ~argument_window() { arguments().pop(saved); }
+
+    unit_ptr* data() const noexcept { return first; }
+    unit_ptr& operator[](::std::size_t const i) const noexcept { return first[i]; }
+
+   private:
+    argument_stack::mark saved;
+    unit_ptr* first;
+  };
+
+}
@@ -4,11 +4,33 @@
 
 namespace yl {
 
-  result_type resolve_symbol(unit_ptr const& pu, env_node_ptr node) noexcept;
+  result_type resolve_symbol(unit_ptr const& pu, env_node_ptr const& node) noexcept;
 
   result_type eval(
     unit_ptr const& pu, 
-    env_node_ptr node = global_environment()
+    env_node_ptr const& node = global_environment()
   ) noexcept;
+
+  // evaluates macro arguments marked with ',' in place, dropping the marks,
+  // yields how many of the count arguments are left
+  either<error_info, ::std::size_t> force_marked(
+    unit_ptr* args, ::std::size_t const count, env_node_ptr const& node
+  ) noexcept;
+
+  // calls the function in callee, builtins get the arguments as they are
+  // and everything else a list unit of the whole call
+  result_type invoke(
+    unit_ptr const& callee,
+    argument_span const& args,
+    position const& pos,
+    env_node_ptr const& env
+  ) noexcept;
+
+  // the builtin bound to id when the interpreter starts, null if none is
+  unit_ptr const* find_builtin(symbol_id const id) noexcept;
+
+  // a name u is bound to when the interpreter starts, no_symbol if it is
+  // not a builtin
+  symbol_id builtin_name(unit const* u) noexcept;
   
 }
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <optional>
+#include <utility>
+
+#include <yl/types.hpp>
+
+namespace yl {
+
+  // value of an expression worked out before it runs, it only stands in
+  // for the expression while the builtins it was folded from keep their
+  // bindings
+  struct folded {
+    unit_ptr value;
+    // heads of the folded calls and the builtins they resolved to
+    seq_representation<::std::pair<unit_ptr, unit_ptr>> guards;
+  };
+
+  // literals, quoted data and calls of pure builtins such as arithmetic,
+  // comparisons, 'len', 'head' and 'tail' on folded arguments, an 'if'
+  // with a folded condition folds to its live branch
+  ::std::optional<folded> fold(unit_ptr const& u) noexcept;
+
+  // condition of an 'if' that is known to be a number
+  ::std::optional<folded> fold_condition(unit_ptr const& u) noexcept;
+
+  // true while every head of the folded calls resolves to the same builtin
+  bool still_holds(folded const& f, env_node_ptr const& node) noexcept;
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+#include <yl/types.hpp>
+
+namespace yl {
+
+  // visits the handles an object owns, lists, hash maps and compiled
+  // closures share their storage between owners, so a handle stored there
+  // is visited once for the address it lives at
+  class tracer {
+   public:
+    virtual void operator()(unit_ptr const&) noexcept = 0;
+    virtual void operator()(env_ptr const&) noexcept = 0;
+    virtual void operator()(env_node_ptr const&) noexcept = 0;
+
+    // whether shared storage at this address has yet to be visited
+    virtual bool first_visit(void const* storage) noexcept = 0;
+
+   protected:
+    ~tracer() = default;
+  };
+
+  void trace(unit const& u, tracer& visit) noexcept;
+  void trace(environment const& env, tracer& visit) noexcept;
+  void trace(env_node const& node, tracer& visit) noexcept;
+  void trace(list const& ls, tracer& visit) noexcept;
+
+  // frees objects that are only kept alive by cycles between them, such
+  // as closures stored in the frames they capture, yields how many
+  ::std::size_t collect_cycles() noexcept;
+
+  // collects once the heap has doubled since the last collection and
+  // hands the slabs that emptied back, only safe between top level forms
+  void collect_cycles_if_grown() noexcept;
+
+}
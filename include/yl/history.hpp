@@ -6,13 +6,15 @@
 
 namespace yl {
 
+  // every line read so far, errors point at them by index. lines typed in
+  // are copied, the lines of a file are read out of its text, which has to
+  // stay around for as long as the history does
   class history {
-#ifdef __EMSCRIPTEN__
-    seq_representation<string_representation> static lines;
-#endif
-
    public:
     static void append(string_representation const&) noexcept;
+    // adds each line of text and yields the index of the first one, they
+    // do not go into the readline history
+    static ::std::size_t append_lines(char const* text, ::std::size_t size) noexcept;
     static string_representation get(::std::size_t const) noexcept;
     static ::std::size_t size() noexcept;
   };
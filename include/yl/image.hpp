@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <yl/types.hpp>
+
+namespace yl {
+
+  // images hold values in a binary form another run of the interpreter
+  // reads back into live units. whatever is reachable from more than one
+  // place is written once and stays shared, user defined functions are
+  // written with their bodies, the frames they closed over and the layouts
+  // of those, builtins by a name they are bound to at startup. functions
+  // are compiled again when read, for whichever engine reads them
+
+  // digest of the text an image is made from
+  ::std::uint64_t image_key(char const* text, ::std::size_t const size) noexcept;
+
+  // writes everything bound in the global environment to path. positions
+  // refer to the text of key, which went into the history at first_line
+  error_either<void> save_globals(
+    char const* path,
+    ::std::uint64_t const key,
+    ::std::size_t const first_line
+  ) noexcept;
+
+  // binds what save_globals wrote in the global environment, the image is
+  // only used if it was made from the same text at the same line
+  error_either<void> load_globals(
+    char const* path,
+    ::std::uint64_t const key,
+    ::std::size_t const first_line
+  ) noexcept;
+
+  // writes value to path without positions. the frames its functions
+  // closed over go with it, except for the global environment, which a
+  // function read back refers to the globals of the reader for
+  error_either<void> save_value(
+    char const* path, unit_ptr const& value, position const& pos
+  ) noexcept;
+
+  // reads back what save_value wrote, every unit of it is at pos
+  result_type load_value(char const* path, position const& pos) noexcept;
+
+}
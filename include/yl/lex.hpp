@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// scanning reads whole aligned blocks, which may go past the terminating
+// null but never into another page
+#if defined(__GNUC__) || defined(__clang__)
+#define YL_BLOCK_SCAN __attribute__((no_sanitize_address))
+#else
+#define YL_BLOCK_SCAN
+#endif
+
+namespace yl {
+
+  namespace detail {
+
+#if defined(__AVX2__)
+    ::std::size_t constexpr scan_block = 32;
+
+    template<char... Cs>
+    YL_BLOCK_SCAN inline ::std::uint32_t scan_matches(char const* aligned) noexcept {
+      auto const v = _mm256_load_si256(reinterpret_cast<__m256i const*>(aligned));
+      auto m = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+      ((m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(Cs)))), ...);
+      return static_cast<::std::uint32_t>(_mm256_movemask_epi8(m));
+    }
+#elif defined(__SSE2__)
+    ::std::size_t constexpr scan_block = 16;
+
+    template<char... Cs>
+    YL_BLOCK_SCAN inline ::std::uint32_t scan_matches(char const* aligned) noexcept {
+      auto const v = _mm_load_si128(reinterpret_cast<__m128i const*>(aligned));
+      auto m = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+      ((m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(Cs)))), ...);
+      return static_cast<::std::uint32_t>(_mm_movemask_epi8(m));
+    }
+#endif
+
+  }
+
+  // first character at or after p that is one of Cs or the terminating null
+  template<char... Cs>
+  YL_BLOCK_SCAN inline char const* scan_to(char const* p) noexcept {
+#if defined(__AVX2__) || defined(__SSE2__)
+    using detail::scan_block;
+    using detail::scan_matches;
+
+    auto const offset =
+      reinterpret_cast<::std::uintptr_t>(p) & (scan_block - 1);
+    auto const* block = p - offset;
+
+    if (auto const bits = scan_matches<Cs...>(block) >> offset; bits) {
+      return p + __builtin_ctz(bits);
+    }
+
+    while (true) {
+      block += scan_block;
+      if (auto const bits = scan_matches<Cs...>(block); bits) {
+        return block + __builtin_ctz(bits);
+      }
+    }
+#else
+    while (*p && ((*p != Cs) && ...)) {
+      ++p;
+    }
+    return p;
+#endif
+  }
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <yl/types.hpp>
+#include <yl/type_operations.hpp>
+
+namespace yl {
+
+  // new layout holding the parameters from arglist followed by the names
+  // that body assigns with '=' or 'decomp'
+  layout_ptr make_layout(list const& arglist, unit_ptr const& body) noexcept;
+
+  // new layout holding names as they are
+  layout_ptr make_layout(seq_representation<symbol_id> names) noexcept;
+
+  // annotates symbols of body with their lexical address for frames of
+  // layout that are created on top of closure
+  void resolve_lexical(
+    unit_ptr const& body,
+    frame_layout const& layout,
+    env_node_ptr const& closure
+  ) noexcept;
+
+  enum class function_kind {
+    regular,
+    macro,
+    syntax
+  };
+
+  // parameters of a user defined function that are still unbound, the first
+  // of them goes into slot offset of the frame
+  struct signature {
+    bool variadic;
+    bool unused;
+    list arglist;
+    ::std::size_t offset;
+    layout_ptr layout;
+  };
+
+  // what a user defined function is made of, whichever engine runs it
+  struct function_parts {
+    signature sig;
+    unit_ptr body;
+    env_node_ptr closure;
+    function_kind fk;
+    env_ptr bound;
+  };
+
+  inline bool is_partial(signature const& sig, ::std::size_t const count) noexcept {
+    return !sig.variadic && sig.arglist.size() > count;
+  }
+
+  // what is left to bind after count arguments were given
+  inline signature partial_signature(signature const& sig, ::std::size_t const count) noexcept {
+    return signature{
+      false, false,
+      sig.arglist.drop(count),
+      sig.offset + count,
+      sig.layout
+    };
+  }
+
+  // frame with count arguments bound, on top of the partially bound frame
+  // if there is one, pos is where errors are reported
+  error_either<env_ptr> bind_arguments(
+    signature const& sig,
+    unit_ptr const* arguments,
+    ::std::size_t const count,
+    position const& pos,
+    env_ptr const& bound
+  ) noexcept;
+
+  inline env_ptr make_frame(layout_ptr const& layout) noexcept {
+    auto slots = make_seq<unit_ptr>();
+    slots.resize(layout->names.size());
+    return make_shared(environment{layout, ::std::move(slots)});
+  }
+
+  // resolved to a slot of the function that encloses it
+  inline bool is_local(string const& sym) noexcept {
+    return sym.site && sym.site->addr.owner
+      && sym.site->addr.slot != lexical_address::global_slot;
+  }
+
+  // bumped by def and '=' when they rebind a global, which drops every
+  // binding that call sites cached from the global environment
+  inline ::std::uint64_t global_version = 1;
+
+  inline unit_ptr const* cached_global(symbol_site& site, symbol_id const id) noexcept {
+    auto& cache = site.cache;
+    if (cache.version != global_version) {
+      cache = global_cache{global_frame()->find(id), global_version};
+    }
+    return cache.binding;
+  }
+
+  inline unit_ptr const* find_in_chain(symbol_id const id, env_node const* frame) noexcept {
+    for (; frame; frame = frame->prev.get()) {
+      if (auto const* value = frame->curr->find(id)) {
+        return value;
+      }
+    }
+    return nullptr;
+  }
+
+  // constant time when the symbol was resolved for the frame in node,
+  // otherwise walks the environment chain
+  inline unit_ptr const* lookup(string const& sym, env_node_ptr const& node) noexcept {
+    if (!sym.site) {
+      return find_in_chain(symbol_of(sym), node.get());
+    }
+
+    auto& site = *sym.site;
+    auto const& addr = site.addr;
+    auto const& layout = node->curr->layout;
+    auto const* frame = node.get();
+
+    if (addr.owner && layout && layout->id == addr.owner) {
+      ::std::uint32_t depth = 0;
+
+      // a name added at runtime to a nearer frame would shadow the slot
+      for (; depth < addr.depth && frame->curr->dynamic.empty(); ++depth) {
+        frame = frame->prev.get();
+      }
+
+      if (depth != addr.depth) {
+        frame = node.get();
+      } else if (addr.slot != lexical_address::global_slot) {
+        if (auto const& value = frame->curr->slots[addr.slot]) {
+          return &value;
+        }
+        frame = node.get();
+      }
+    }
+
+    // nothing between node and the global environment binds the name
+    if (frame->curr == global_frame()) {
+      if (auto const* value = cached_global(site, symbol_of(sym))) {
+        return value;
+      }
+    }
+
+    return find_in_chain(symbol_of(sym), node.get());
+  }
+
+}
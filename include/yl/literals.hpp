@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_set>
+
+#include <yl/mem.hpp>
+#include <yl/types.hpp>
+
+namespace yl {
+
+  struct same_unit {
+    bool operator()(unit_ptr const& a, unit_ptr const& b) const noexcept {
+      return a == b;
+    }
+  };
+
+  // hash conses numbers, raw strings and lists made of nothing else, so
+  // equal literal structure is kept once and compares by pointer. symbols
+  // carry what evaluation learns about their site and are never shared,
+  // neither is anything containing one. a shared unit keeps the position
+  // it was first seen at, the parser shares only the nodes of lists
+  class literal_table {
+   public:
+    literal_table() noexcept = default;
+
+    literal_table(literal_table const&) = delete;
+    literal_table& operator=(literal_table const&) = delete;
+
+    // the unit everything equal to u should be, u itself if it can not be
+    // shared or was not seen before
+    unit_ptr share(unit_ptr u) noexcept;
+
+    // true if u is a number, a raw string or a list equal to one this
+    // table holds
+    bool is_literal(unit_ptr const& u) const noexcept;
+
+    ::std::size_t size() const noexcept {
+      return units.size();
+    }
+
+   private:
+    // units only the table holds are dropped once it doubles
+    void prune() noexcept;
+
+    PMR_PREF::unordered_set<unit_ptr, unit_hasher, same_unit> units{
+#ifndef __EMSCRIPTEN__
+      static_pool
+#endif
+    };
+    ::std::size_t limit = 1 << 12;
+  };
+
+  // used by the parser when literals are shared between top level forms
+  literal_table& parsed_literals() noexcept;
+
+}
@@ -6,8 +6,12 @@
 #include <memory_resource>
 #endif
 #include <string>
+#include <type_traits>
 #include <utility>
 
+#include <yl/region.hpp>
+#include <yl/slab.hpp>
+
 #ifndef __EMSCRIPTEN__
 #define PMR_PREF ::std::pmr
 #else
@@ -17,26 +21,24 @@
 namespace yl {
 
 #ifndef __EMSCRIPTEN__
-  ::std::pmr::unsynchronized_pool_resource inline mem_pool{};
+  inline region mem_pool{};
+
+  // the symbols, literals and globals grow a node at a time for as long as
+  // the program runs, each node would pin the chunk of mem_pool it came from
+  inline ::std::pmr::memory_resource* const static_pool =
+    ::std::pmr::new_delete_resource();
 #endif
 
-  using string_representation = PMR_PREF::string;
+  // a pmr string carries its resource, which would not leave room for the
+  // metadata of a symbol in a unit
+  using string_representation = ::std::string;
 
   inline string_representation make_string() noexcept {
-    return string_representation{
-#ifndef __EMSCRIPTEN__
-      &mem_pool
-#endif
-    };
+    return string_representation{};
   }
 
   inline string_representation make_string(char const* charr) noexcept {
-    return string_representation{
-      charr
-#ifndef __EMSCRIPTEN__
-      , &mem_pool
-#endif
-    };
+    return string_representation{charr};
   }
 
   inline string_representation make_string(string_representation const& str) noexcept {
@@ -45,12 +47,7 @@ namespace yl {
 
   template<typename Iter>
   inline string_representation make_string(Iter begin, Iter end) noexcept {
-    return string_representation{
-      begin, end
-#ifndef __EMSCRIPTEN__
-      , &mem_pool
-#endif
-    };
+    return string_representation{begin, end};
   }
 
   template<typename T>
@@ -75,21 +72,6 @@ namespace yl {
     };
   }
 
-  // gotta go fast, even if without brain
-  struct str_hasher {
-    ::std::size_t operator()(string_representation const& str) const noexcept {
-      switch (str.size()) {
-        case 0:
-          return 0;
-        case 1:
-          return str[0];
-        default:
-          return (static_cast<::std::size_t>(str[0]) << 8) 
-                  ^ static_cast<::std::size_t>(str[1]);
-      }
-    }
-  };
-
 #ifndef __EMSCRIPTEN__
   namespace detail {
 
@@ -100,28 +82,184 @@ namespace yl {
 #endif
 
 
+  // objects the interpreter copies handles of all the time opt into a
+  // plain reference count stored in front of them, evaluation is single
+  // threaded so it does not need to be atomic and there is no separate
+  // control block to allocate
+  template<typename T>
+  struct intrusive : ::std::false_type {};
+
+  // every allocated object is linked into the heap of its type, so that
+  // the cycle collector can find the ones nothing outside the heap reaches
+  struct counted_links {
+    counted_links* prev = nullptr;
+    counted_links* next = nullptr;
+
+    bool linked() const noexcept { return next; }
+
+    void link(counted_links& head) noexcept {
+      prev = &head;
+      next = head.next;
+      head.next->prev = this;
+      head.next = this;
+    }
+
+    void unlink() noexcept {
+      if (next) {
+        prev->next = next;
+        next->prev = prev;
+      }
+    }
+  };
+
+  // whatever a type caches about each of its objects next to the count,
+  // nothing unless it is specialized
+  template<typename T>
+  struct counted_metadata {};
+
+  template<typename T>
+  struct counted : counted_links, counted_metadata<T> {
+    ::std::size_t refs;
+    T value;
+  };
+
+  template<typename T>
+  counted_links& heap_of() noexcept {
+    static counted_links head{&head, &head};
+    return head;
+  }
+
+  // objects linked into any heap
+  inline ::std::size_t heap_size = 0;
+
+  template<typename T>
+  class ref {
+   public:
+    ref() noexcept = default;
+    ref(::std::nullptr_t) noexcept {}
+
+    // shares ownership of a block that is already counted
+    explicit ref(counted<T>* block) noexcept : block{block} { retain(); }
+
+    ref(ref const& other) noexcept : block{other.block} { retain(); }
+    ref(ref&& other) noexcept : block{other.block} { other.block = nullptr; }
+
+    ~ref() { release(); }
+
+    ref& operator=(ref const& other) noexcept {
+      other.retain();
+      release();
+      block = other.block;
+      return *this;
+    }
+
+    ref& operator=(ref&& other) noexcept {
+      if (this != &other) {
+        release();
+        block = other.block;
+        other.block = nullptr;
+      }
+      return *this;
+    }
+
+    T* get() const noexcept { return block ? &block->value : nullptr; }
+    T& operator*() const noexcept { return block->value; }
+    T* operator->() const noexcept { return &block->value; }
+
+    explicit operator bool() const noexcept { return block; }
+
+    void reset() noexcept {
+      release();
+      block = nullptr;
+    }
+
+    ::std::size_t use_count() const noexcept { return block ? block->refs : 0; }
+
+    counted<T>* counted_block() const noexcept { return block; }
+
+   private:
+    void retain() const noexcept {
+      if (block) {
+        ++block->refs;
+      }
+    }
+
+    void release() noexcept {
+      if (block && !--block->refs) {
+        if (block->linked()) {
+          block->unlink();
+          --heap_size;
+        }
+        block->~counted();
+        slabs_for<counted<T>>.deallocate(block);
+      }
+    }
+
+    counted<T>* block = nullptr;
+  };
+
+  template<typename T, typename U>
+  bool operator==(ref<T> const& a, ref<U> const& b) noexcept {
+    return a.get() == b.get();
+  }
+
+  template<typename T, typename U>
+  bool operator!=(ref<T> const& a, ref<U> const& b) noexcept {
+    return !(a == b);
+  }
+
+  template<typename T>
+  bool operator==(ref<T> const& a, ::std::nullptr_t) noexcept {
+    return !a;
+  }
+
+  template<typename T>
+  bool operator!=(ref<T> const& a, ::std::nullptr_t) noexcept {
+    return static_cast<bool>(a);
+  }
+
+  template<typename T, typename... Args>
+  ref<T> make_counted(Args&& ...args) noexcept {
+    auto* block = static_cast<counted<T>*>(slabs_for<counted<T>>.allocate());
+    new (block) counted<T>{{}, {}, 0, T{::std::forward<Args>(args)...}};
+    block->link(heap_of<T>());
+    ++heap_size;
+    return ref<T>{block};
+  }
+
   template<typename T>
-  ::std::shared_ptr<T> make_shared(T&& t) noexcept {
+  using handle = ::std::conditional_t<intrusive<T>::value, ref<T>, ::std::shared_ptr<T>>;
+
+  template<typename T>
+  handle<T> make_shared(T&& t) noexcept {
+    if constexpr (intrusive<T>::value) {
+      return make_counted<T>(::std::forward<T>(t));
+    } else {
 #ifndef __EMSCRIPTEN__
-    return ::std::allocate_shared<T, detail::pmr_alloc_t<T>>(
-      &mem_pool, ::std::forward<T>(t)
-    );
+      return ::std::allocate_shared<T, detail::pmr_alloc_t<T>>(
+        &mem_pool, ::std::forward<T>(t)
+      );
 #else
-    return ::std::make_shared<T>(::std::forward<T>(t));
+      return ::std::make_shared<T>(::std::forward<T>(t));
 #endif
+    }
   }
   
   template<typename T, typename... Args>
-  ::std::shared_ptr<T> make_shared(Args&& ...args) noexcept {
+  handle<T> make_shared(Args&& ...args) noexcept {
+    if constexpr (intrusive<T>::value) {
+      return make_counted<T>(::std::forward<Args>(args)...);
+    } else {
 #ifndef __EMSCRIPTEN__
-    auto ret = ::std::allocate_shared<T, detail::pmr_alloc_t<T>>(
-      &mem_pool
-    );
+      auto ret = ::std::allocate_shared<T, detail::pmr_alloc_t<T>>(
+        &mem_pool
+      );
 #else
-    auto ret = ::std::make_shared<T>();
+      auto ret = ::std::make_shared<T>();
 #endif
-    new (ret.get()) T{::std::forward<Args>(args)...}; // smelly
-    return ret;
+      new (ret.get()) T{::std::forward<Args>(args)...}; // smelly
+      return ret;
+    }
   }
 
 }
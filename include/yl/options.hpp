@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace yl {
+
+  // set from the command line before anything is evaluated
+  struct interpreter_options {
+    // top level forms and user defined functions run on the bytecode vm
+    bool vm = false;
+    // calls of pure builtins on literals are worked out ahead of time
+    bool fold = true;
+    // closures kept alive only by the frames they capture are freed
+    // between top level forms
+    bool collect = true;
+    // slabs of runtime objects are 2 MB and backed by transparent huge
+    // pages, must be set before anything is allocated
+    bool huge_pages = false;
+    // equal numbers, raw strings and lists of them read by the parser are
+    // kept once, errors point at the first place such a literal was read
+    bool share_literals = false;
+    // calls the vm keeps on its heap stack at once
+    ::std::size_t max_depth = 1000000;
+    // bytes of native stack evaluation can use before it is stopped
+#ifdef __EMSCRIPTEN__
+    ::std::size_t native_stack = 32 << 10;
+#else
+    ::std::size_t native_stack = 4 << 20;
+#endif
+  };
+
+  inline interpreter_options options{};
+
+  // address close to where evaluation of the current input started
+  inline ::std::uintptr_t stack_start = 0;
+
+  // deep recursion through the native stack fails with an error before
+  // the stack overflows
+  inline bool native_stack_exhausted() noexcept {
+    char here;
+    auto const now = reinterpret_cast<::std::uintptr_t>(&here);
+    return stack_start && stack_start > now
+      && stack_start - now > options.native_stack;
+  }
+
+}
@@ -6,6 +6,13 @@ namespace yl {
 
   result_type parse(char const* line, ::std::size_t const line_num) noexcept;
 
+  // parses the form that runs from begin to end of text, which may span
+  // lines. line_num is the number of the line begin is on, the lines after
+  // it are numbered on from there
+  result_type parse(
+    char const* text, ::std::size_t const begin, ::std::size_t const end,
+    ::std::size_t const line_num) noexcept;
+
   int paren_balance(char const* line) noexcept;
 
   ::std::size_t skip_str(char const* line, ::std::size_t pos) noexcept;
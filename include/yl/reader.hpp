@@ -0,0 +1,64 @@
+#pragma once
+
+#include <yl/mem.hpp>
+
+namespace yl {
+
+  // gathers the lines of a form until its parentheses balance. every line
+  // is looked at once as it is appended, the form grows in place and is
+  // handed to the parser as is
+  class form_reader {
+   public:
+    // strips the comment from line and adds what is left, false if nothing
+    // but blanks was left and the line was skipped
+    bool append(char* line) noexcept;
+
+    // true once at least one line was added and every parenthesis opened
+    // so far was closed again
+    bool complete() const noexcept {
+      return lines && balance >= 0;
+    }
+
+    // the first line left a parenthesis open
+    bool continuated() const noexcept {
+      return lines > 1 || balance < 0;
+    }
+
+    char const* form() const noexcept {
+      return buffer.c_str();
+    }
+
+   private:
+    string_representation buffer = make_string();
+    int balance = 0;
+    ::std::size_t lines = 0;
+  };
+
+  // a top level form of a file, from the start of its first line to the
+  // end of its last
+  struct form_span {
+    ::std::size_t begin;
+    ::std::size_t end;
+    ::std::size_t first_line;
+    ::std::size_t last_line;
+  };
+
+  // splits a whole file into the forms form_reader would have gathered
+  // from its lines, in a single pass and without copying anything. text
+  // has to be followed by a null
+  class source_reader {
+   public:
+    source_reader(char const* text, ::std::size_t const size) noexcept
+      : text{text}, size{size} {}
+
+    // false once the text is used up
+    bool next(form_span& form) noexcept;
+
+   private:
+    char const* text;
+    ::std::size_t size;
+    ::std::size_t curr = 0;
+    ::std::size_t line = 0;
+  };
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#ifndef __EMSCRIPTEN__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+namespace yl {
+
+  struct region_stats {
+    ::std::size_t chunks = 0;
+    // full chunks kept by allocations that outlived the rest of the chunk
+    ::std::size_t pinned = 0;
+    // empty chunks waiting to be allocated from again
+    ::std::size_t spare = 0;
+  };
+
+  // bump allocates out of aligned chunks and only counts how many
+  // allocations of a chunk are still alive, freeing one is a decrement
+  // and a chunk is reset as a whole once its count drops to zero. the
+  // temporaries of a top level form go away together when it finishes,
+  // which takes the chunk they were in back to its start, values that
+  // outlive the form keep their chunk until they die as well. tables that
+  // live as long as the program allocate from static_pool instead
+  class region final : public ::std::pmr::memory_resource {
+   public:
+    static constexpr ::std::size_t chunk_size = ::std::size_t{1} << 16;
+    // anything bigger goes straight to the global allocator
+    static constexpr ::std::size_t max_small = chunk_size / 16;
+
+    constexpr region() noexcept = default;
+
+    region(region const&) = delete;
+    region& operator=(region const&) = delete;
+
+    // chunks are never handed back, objects with static storage may still
+    // free into them while the program exits
+    ~region() override = default;
+
+    region_stats stats() const noexcept {
+      return {chunks, pinned, spare};
+    }
+
+   private:
+    struct chunk {
+      ::std::size_t live;
+      // no longer allocated from, goes to the free list once empty
+      bool retired;
+      chunk* next;
+    };
+
+    static constexpr ::std::size_t header =
+      (sizeof(chunk) + alignof(::std::max_align_t) - 1)
+        & ~(alignof(::std::max_align_t) - 1);
+
+    static bool is_small(::std::size_t const bytes, ::std::size_t const align) noexcept {
+      return bytes <= max_small && align <= alignof(::std::max_align_t);
+    }
+
+    static chunk* chunk_of(void* p) noexcept {
+      return reinterpret_cast<chunk*>(
+        reinterpret_cast<::std::uintptr_t>(p) & ~(chunk_size - 1)
+      );
+    }
+
+    static ::std::byte* start_of(chunk* c) noexcept {
+      return reinterpret_cast<::std::byte*>(c) + header;
+    }
+
+    void* do_allocate(::std::size_t const bytes, ::std::size_t const align) override {
+      if (!is_small(bytes, align)) {
+        return ::operator new(bytes, ::std::align_val_t{align});
+      }
+
+      auto const aligned = (reinterpret_cast<::std::uintptr_t>(cursor) + align - 1)
+        & ~(align - 1);
+      if (!current || aligned + bytes > reinterpret_cast<::std::uintptr_t>(end)) {
+        return allocate_from_next(bytes);
+      }
+
+      cursor = reinterpret_cast<::std::byte*>(aligned + bytes);
+      ++current->live;
+      return reinterpret_cast<void*>(aligned);
+    }
+
+    void do_deallocate(void* p, ::std::size_t const bytes, ::std::size_t const align) override {
+      if (!is_small(bytes, align)) {
+        ::operator delete(p, ::std::align_val_t{align});
+        return;
+      }
+
+      auto* const c = chunk_of(p);
+      if (--c->live) {
+        return;
+      }
+
+      if (c == current) {
+        cursor = start_of(c);
+      } else if (c->retired) {
+        c->retired = false;
+        c->next = free;
+        free = c;
+        --pinned;
+        ++spare;
+      }
+    }
+
+    bool do_is_equal(::std::pmr::memory_resource const& other) const noexcept override {
+      return this == &other;
+    }
+
+    // the current chunk is full, it stays around for as long as anything
+    // allocated from it is alive
+    void* allocate_from_next(::std::size_t const bytes) {
+      if (current) {
+        current->retired = true;
+        ++pinned;
+      }
+
+      if (free) {
+        current = free;
+        free = free->next;
+        --spare;
+      } else {
+        current = static_cast<chunk*>(
+          ::operator new(chunk_size, ::std::align_val_t{chunk_size})
+        );
+        ++chunks;
+      }
+
+      current->live = 1;
+      current->retired = false;
+      current->next = nullptr;
+
+      auto* const first = start_of(current);
+      cursor = first + bytes;
+      end = reinterpret_cast<::std::byte*>(current) + chunk_size;
+      return first;
+    }
+
+    chunk* current = nullptr;
+    ::std::byte* cursor = nullptr;
+    ::std::byte* end = nullptr;
+    // empty chunks ready to be allocated from again
+    chunk* free = nullptr;
+    ::std::size_t chunks = 0;
+    ::std::size_t pinned = 0;
+    ::std::size_t spare = 0;
+  };
+
+}
+
+#endif
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace yl {
+
+  // how full the slabs of one object size are
+  struct slab_stats {
+    ::std::size_t object_size = 0;
+    ::std::size_t slabs = 0;
+    // objects handed out and not freed yet
+    ::std::size_t used = 0;
+    // objects the slabs have room for
+    ::std::size_t capacity = 0;
+  };
+
+  namespace detail {
+
+    // slabs are aligned to their size, so an object finds its slab by
+    // masking its address
+    void* map_slab(::std::size_t const size, bool const huge) noexcept;
+    void unmap_slab(void* slab, ::std::size_t const size) noexcept;
+
+    constexpr ::std::size_t round_up(::std::size_t const n) noexcept {
+      auto constexpr alignment = alignof(::std::max_align_t);
+      return (n + alignment - 1) & ~(alignment - 1);
+    }
+
+  }
+
+  // objects of a single size carved out of big aligned slabs, each slab
+  // keeps its own free list so that empty ones can be handed back
+  class slab_pool {
+   public:
+    // slabs are this big unless they are backed by huge pages
+    static constexpr ::std::size_t slab_size = ::std::size_t{1} << 16;
+    static constexpr ::std::size_t huge_slab_size = ::std::size_t{1} << 21;
+
+    explicit constexpr slab_pool(::std::size_t const object_size) noexcept
+      : object_size{detail::round_up(object_size)} {}
+
+    slab_pool(slab_pool const&) = delete;
+    slab_pool& operator=(slab_pool const&) = delete;
+
+    void* allocate() noexcept {
+      auto* s = partial ? partial : grow();
+
+      void* p;
+      if (s->free) {
+        p = s->free;
+        s->free = s->free->next;
+      } else {
+        p = s->bump;
+        s->bump += object_size;
+      }
+
+      if (!s->free && s->bump + object_size > s->end) {
+        unlink(s);
+      }
+
+      ++s->live;
+      return p;
+    }
+
+    void deallocate(void* p) noexcept {
+      auto* const s = slab_of(p);
+      auto* const object = static_cast<free_object*>(p);
+      object->next = s->free;
+      s->free = object;
+      --s->live;
+
+      if (!s->listed) {
+        link(s);
+      }
+    }
+
+    // hands empty slabs back to the system, yields how many bytes
+    ::std::size_t trim() noexcept;
+
+    slab_stats stats() const noexcept;
+
+    // every pool that has allocated a slab so far
+    static slab_pool* first() noexcept { return pools; }
+    slab_pool* next() const noexcept { return next_pool; }
+
+   private:
+    struct free_object {
+      free_object* next;
+    };
+
+    struct slab {
+      slab* prev;
+      slab* next;
+      free_object* free;
+      // start of the part that was never handed out
+      ::std::byte* bump;
+      ::std::byte* end;
+      ::std::size_t live;
+      // in the list of slabs with room left
+      bool listed;
+    };
+
+    static constexpr ::std::size_t header = detail::round_up(sizeof(slab));
+
+    slab* slab_of(void* p) const noexcept {
+      return reinterpret_cast<slab*>(
+        reinterpret_cast<::std::uintptr_t>(p) & ~(bytes - 1)
+      );
+    }
+
+    void link(slab* s) noexcept {
+      s->prev = nullptr;
+      s->next = partial;
+      if (partial) {
+        partial->prev = s;
+      }
+      partial = s;
+      s->listed = true;
+    }
+
+    void unlink(slab* s) noexcept {
+      if (s->prev) {
+        s->prev->next = s->next;
+      } else {
+        partial = s->next;
+      }
+      if (s->next) {
+        s->next->prev = s->prev;
+      }
+      s->listed = false;
+    }
+
+    slab* grow() noexcept;
+
+    ::std::size_t object_size;
+    // size of the slabs, fixed once the first one is mapped
+    ::std::size_t bytes = 0;
+    // full slabs are not in any list, only counted
+    ::std::size_t slabs = 0;
+    slab* partial = nullptr;
+    slab_pool* next_pool = nullptr;
+
+    static inline slab_pool* pools = nullptr;
+  };
+
+  // trims every pool, yields how many bytes went back to the system
+  ::std::size_t trim_slabs() noexcept;
+
+  // one pool per type, constant initialized and trivially destructible,
+  // so objects with static storage can use it at any point
+  template<typename T>
+  inline slab_pool slabs_for{sizeof(T)};
+
+}
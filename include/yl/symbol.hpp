@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+#include <yl/mem.hpp>
+
+namespace yl {
+
+  // symbols are interned once by the parser, everything past it works with ids
+
+  using symbol_id = ::std::uint32_t;
+
+  symbol_id constexpr no_symbol = ~symbol_id{0};
+
+  symbol_id intern(string_representation const& name) noexcept;
+
+  string_representation const& symbol_name(symbol_id const id) noexcept;
+
+}
@@ -1,6 +1,7 @@
   #pragma once
 
   #include <functional>
+  #include <type_traits>
   #include <utility>
   #include <yl/types.hpp>
 
@@ -18,10 +19,16 @@
 
     DEF_CAST(numeric);
     DEF_CAST(string);
-    DEF_CAST(function);
     DEF_CAST(list);
     DEF_CAST(hash_map);
 
+    inline function& as_function(expression& expr) noexcept {
+      return *::std::get<out_of_line<function>>(expr);
+    }
+    inline function const& as_function(expression const& expr) noexcept {
+      return *::std::get<out_of_line<function>>(expr);
+    }
+
   #define DEF_TYPE_CHECK(type) \
     inline bool is_##type(expression const& expr) noexcept { \
       return ::std::holds_alternative<type>(expr); \
@@ -29,12 +36,43 @@
 
     DEF_TYPE_CHECK(numeric);
     DEF_TYPE_CHECK(string);
-    DEF_TYPE_CHECK(function);
     DEF_TYPE_CHECK(list);
     DEF_TYPE_CHECK(hash_map);
 
+    inline bool is_function(expression const& expr) noexcept {
+      return ::std::holds_alternative<out_of_line<function>>(expr);
+    }
+
+    // numbers and empty lists come from the immediates when they can
+    template<typename T>
+    unit_ptr make_value(position const& pos, T&& expr) noexcept {
+      using type = ::std::decay_t<T>;
+      if constexpr (::std::is_arithmetic_v<type>) {
+        return make_numeric(pos, static_cast<numeric>(expr));
+      } else if constexpr (::std::is_same_v<type, list>) {
+        return expr.empty()
+          ? make_nil()
+          : ::yl::make_shared<unit>(pos, ::std::forward<T>(expr));
+      } else {
+        return ::yl::make_shared<unit>(pos, ::std::forward<T>(expr));
+      }
+    }
+
+    // the value of a unit nothing else refers to, such as the result of a
+    // nested call, is moved out so that updating it reuses its storage,
+    // variables and the immediates always have another owner
+    template<typename T>
+    T reuse(unit_ptr const& u) noexcept {
+      auto& value = ::std::get<T>(u->expr);
+      if (u.use_count() == 1) {
+        u.counted_block()->hash = 0;
+        return ::std::move(value);
+      }
+      return value;
+    }
+
   #define SUCCEED_WITH(pos, expr) \
-    return succeed(::yl::make_shared<unit>(pos, expr));
+    return succeed(::yl::make_value(pos, expr));
 
   #define FAIL_WITH(msg, pos) \
     return fail(error_info{ \
@@ -50,8 +88,10 @@
     // functional style casts
 
   #define DEF_FUNC_CAST(type) \
-    inline error_either<type> cast_##type(unit_ptr const& u_ptr) noexcept { \
-      auto& [pos, expr] = *u_ptr; \
+    inline error_either<type> cast_##type( \
+      unit_ptr const& u_ptr, position const& pos \
+    ) noexcept { \
+      auto& expr = u_ptr->expr; \
       if (is_##type(expr)) { \
         return succeed(as_##type(expr)); \
       } \
@@ -61,6 +101,9 @@
           .pos = pos \
         } \
       ); \
+    } \
+    inline error_either<type> cast_##type(unit_ptr const& u_ptr) noexcept { \
+      return cast_##type(u_ptr, u_ptr->pos); \
     }
 
     DEF_FUNC_CAST(numeric);
@@ -137,6 +180,10 @@
 
 // operations on types
 
+    inline symbol_id symbol_of(string const& sym) noexcept {
+      return sym.id != no_symbol ? sym.id : intern(sym.str);
+    }
+
     inline auto len(unit_ptr const& u) noexcept {
       return cast_qr(u).or_die().collect(
         [](auto&& ls) { return ls.size(); },
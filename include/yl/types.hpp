@@ -1,16 +1,24 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <functional>
 #include <unordered_map>
 #include <utility>
 #include <variant>
 
+#include <immer/flex_vector.hpp>
+#include <immer/flex_vector_transient.hpp>
+#include <immer/heap/heap_policy.hpp>
+#include <immer/lock/no_lock_policy.hpp>
 #include <immer/map.hpp>
 #include <immer/map_transient.hpp>
+#include <immer/memory_policy.hpp>
+#include <immer/refcount/unsafe_refcount_policy.hpp>
 
 #include <yl/either.hpp>
 #include <yl/mem.hpp>
+#include <yl/symbol.hpp>
 
 namespace yl {
 
@@ -18,26 +26,127 @@ namespace yl {
 
   // holds a type and metadata
   struct unit;
-  using unit_ptr = ::std::shared_ptr<unit>;
+  template<> struct intrusive<unit> : ::std::true_type {};
+  using unit_ptr = ref<unit>;
 
-  // struct
+  // units never change once built, so the hash of a string, list or map
+  // is computed the first time it is needed and kept in front of the
+  // unit, where the slab has room for it anyway
+  template<>
+  struct counted_metadata<unit> {
+    // zero until computed
+    ::std::size_t hash = 0;
+  };
+
+  // structural, consistent with operator== on units
   struct unit_hasher {
     ::std::size_t operator()(unit_ptr const&) const noexcept;
   };
 
+  // where a symbol lives relative to the frame of the function that
+  // resolved it, only valid while evaluating in a frame of that function
+  struct lexical_address {
+    // names the function does not bind that resolve to the global environment
+    static constexpr ::std::uint32_t global_slot = ~::std::uint32_t{0};
+
+    ::std::uint64_t owner = 0;
+    ::std::uint32_t depth = 0;
+    ::std::uint32_t slot = 0;
+  };
+
+  // binding a symbol last found in the global environment, valid while
+  // the global bindings stay at version
+  struct global_cache {
+    unit_ptr const* binding = nullptr;
+    ::std::uint64_t version = 0;
+  };
+
+  // payload that is kept outside of the unit so that it does not make
+  // every unit as big as itself, copies of it are deep
+  template<typename T>
+  class out_of_line {
+   public:
+    out_of_line() noexcept = default;
+    out_of_line(T value) noexcept
+      : ptr{::std::make_unique<T>(::std::move(value))} {}
+
+    out_of_line(out_of_line const& other) noexcept
+      : ptr{other.ptr ? ::std::make_unique<T>(*other.ptr) : nullptr} {}
+    out_of_line(out_of_line&&) noexcept = default;
+
+    out_of_line& operator=(out_of_line const& other) noexcept {
+      ptr = other.ptr ? ::std::make_unique<T>(*other.ptr) : nullptr;
+      return *this;
+    }
+    out_of_line& operator=(out_of_line&&) noexcept = default;
+
+    explicit operator bool() const noexcept { return static_cast<bool>(ptr); }
+
+    T& operator*() const noexcept { return *ptr; }
+    T* operator->() const noexcept { return ptr.get(); }
+
+   private:
+    ::std::unique_ptr<T> ptr;
+  };
+
+  // what evaluation learned about where a symbol is bound
+  struct symbol_site {
+    lexical_address addr = {};
+    global_cache cache = {};
+  };
+
   struct string {
     string_representation str = make_string();
     bool raw = false;
+    // set by the parser for symbols
+    symbol_id id = no_symbol;
+    out_of_line<symbol_site> site = {};
   };
 
-  using list = seq_representation<unit_ptr>;
-  inline auto make_list() noexcept { return make_seq<unit_ptr>(); }
+  // nodes of lists come from the same pool as everything else, and like
+  // units they are never shared between threads
+  struct list_heap {
+    template<typename... Tags>
+    static void* allocate(::std::size_t const size, Tags...) noexcept {
+#ifndef __EMSCRIPTEN__
+      return mem_pool.allocate(size);
+#else
+      return ::operator new(size);
+#endif
+    }
+
+    template<typename... Tags>
+    static void deallocate(::std::size_t const size, void* data, Tags...) noexcept {
+#ifndef __EMSCRIPTEN__
+      mem_pool.deallocate(data, size);
+#else
+      ::operator delete(data);
+#endif
+    }
+  };
+
+  using list_memory = ::immer::memory_policy<
+    ::immer::heap_policy<list_heap>,
+    ::immer::unsafe_refcount_policy,
+    ::immer::no_lock_policy
+  >;
+
+  // persistent, so taking the tail, consing or joining shares the nodes
+  // of the original instead of copying every element
+  using list = ::immer::flex_vector<unit_ptr, list_memory>;
+  inline list make_list() noexcept { return list{}; }
+
+  template<typename Iter>
+  inline list make_list(Iter begin, Iter end) noexcept {
+    return list(begin, end);
+  }
 
   struct function;
   using numeric = ::std::int64_t;
   using hash_map = ::immer::map<unit_ptr, unit_ptr, unit_hasher>;
 
-  using expression = ::std::variant<numeric, string, list, function, hash_map>;
+  using expression =
+    ::std::variant<numeric, string, list, out_of_line<function>, hash_map>;
 
   ::std::ostream& operator<<(::std::ostream& out, expression const&) noexcept;
   bool operator==(unit_ptr const&, unit_ptr const&) noexcept;
@@ -46,11 +155,71 @@ namespace yl {
 
   // environment
 
-  using environment = 
-    PMR_PREF::unordered_map<string_representation, unit_ptr, str_hasher>;
+  // names known when a function is created: parameters first, then locals
+  // assigned in its body, shared by every call of that function
+  struct frame_layout {
+    ::std::uint64_t id;
+    seq_representation<symbol_id> names;
+  };
+
+  using layout_ptr = ::std::shared_ptr<frame_layout const>;
+
+  // function frames keep their statically known names in a flat array,
+  // anything else (globals, '=' from evaluated code) goes into the map
+  struct environment {
+    layout_ptr layout = {};
+    seq_representation<unit_ptr> slots = make_seq<unit_ptr>();
+    PMR_PREF::unordered_map<symbol_id, unit_ptr> dynamic{
+#ifndef __EMSCRIPTEN__
+      &mem_pool
+#endif
+    };
+
+    unit_ptr* find(symbol_id const id) noexcept {
+      if (layout) {
+        auto const& names = layout->names;
+        for (::std::size_t i = 0; i < names.size(); ++i) {
+          if (names[i] == id) {
+            return slots[i] ? &slots[i] : nullptr;
+          }
+        }
+      }
+      auto const iter = dynamic.find(id);
+      return iter == dynamic.end() ? nullptr : &iter->second;
+    }
+
+    void assign(symbol_id const id, unit_ptr value) noexcept {
+      if (layout) {
+        auto const& names = layout->names;
+        for (::std::size_t i = 0; i < names.size(); ++i) {
+          if (names[i] == id) {
+            slots[i] = ::std::move(value);
+            return;
+          }
+        }
+      }
+      dynamic[id] = ::std::move(value);
+    }
+
+    template<typename F>
+    void for_each(F&& f) const noexcept {
+      for (::std::size_t i = 0; layout && i < slots.size(); ++i) {
+        if (slots[i]) {
+          f(layout->names[i], slots[i]);
+        }
+      }
+      for (auto const& [id, value] : dynamic) {
+        f(id, value);
+      }
+    }
+  };
+
+  struct env_node;
+  template<> struct intrusive<environment> : ::std::true_type {};
+  template<> struct intrusive<env_node> : ::std::true_type {};
 
-  using env_ptr      = ::std::shared_ptr<environment>;
-  using env_node_ptr = ::std::shared_ptr<struct env_node>;
+  using env_ptr      = ref<environment>;
+  using env_node_ptr = ref<env_node>;
 
   struct env_node {
     env_ptr curr;
@@ -58,12 +227,14 @@ namespace yl {
   };
 
   env_node_ptr global_environment() noexcept;
+  env_ptr const& global_frame() noexcept;
 
   // helpers for error reporting
   
+  // line is the index of the input in the history
   struct position {
-    ::std::size_t line;
-    ::std::size_t column;
+    ::std::uint32_t line;
+    ::std::uint32_t column;
   };
   
   struct error_info {
@@ -81,12 +252,50 @@ namespace yl {
   using error_either = either<error_info, Result>;
   using result_type = error_either<unit_ptr>;
 
+  namespace vm {
+    struct closure;
+  }
+
+  // arguments of a call, already evaluated unless the callee is a macro,
+  // the caller owns them and keeps them alive for the duration of the call
+  struct argument_span {
+    unit_ptr const* first = nullptr;
+    ::std::size_t count = 0;
+    // call the arguments were evaluated from, if the caller has it, its
+    // first element is the function
+    list const* call = nullptr;
+
+    ::std::size_t size() const noexcept { return count; }
+    bool empty() const noexcept { return !count; }
+
+    unit_ptr const& operator[](::std::size_t const i) const noexcept {
+      return first[i];
+    }
+
+    unit_ptr const* begin() const noexcept { return first; }
+    unit_ptr const* end() const noexcept { return first + count; }
+
+    unit_ptr const& back() const noexcept { return first[count - 1]; }
+
+    // where errors about argument i should point
+    position const& pos_of(::std::size_t const i) const noexcept;
+  };
+
   struct function {
-    using type = ::std::function<result_type(unit_ptr const&, env_node_ptr&)>;
+    // the whole call as a list unit, the function itself first
+    using type = ::std::function<result_type(unit_ptr const&, env_node_ptr const&)>;
+    // builtins get their arguments without a list being built for them
+    using builtin_type =
+      result_type(*)(argument_span const&, position const&, env_node_ptr const&);
+
     string_representation description = make_string();
     type func;
 
     bool macro = false;
+    // set when the body runs on the vm, lets it call the function in place
+    ::std::shared_ptr<vm::closure const> compiled = {};
+    // set for builtins, func then only adapts the old convention to it
+    builtin_type builtin = nullptr;
   };
 
   struct unit {
@@ -94,4 +303,87 @@ namespace yl {
     expression expr;
   };
 
+  // lists of units are walked a lot, keep each one within a cache line
+  static_assert(sizeof(unit) <= 64, "unit does not fit into a cache line");
+
+  // small integers, which include the booleans comparisons return, and the
+  // empty list are shared instead of allocated for every result, they
+  // carry no position of their own
+  class immediates {
+   public:
+    static constexpr numeric min_integer = -512;
+    static constexpr numeric max_integer = 1023;
+
+    // never destroyed, units that outlive it may still hold handles
+    static immediates const& get() noexcept {
+      static immediates const* const table = new immediates;
+      return *table;
+    }
+
+    bool has_integer(numeric const n) const noexcept {
+      return n >= min_integer && n <= max_integer;
+    }
+
+    unit_ptr const& integer(numeric const n) const noexcept {
+      return handles[n - min_integer];
+    }
+
+    unit_ptr const& nil() const noexcept {
+      return handles[count - 1];
+    }
+
+    bool contains(unit const* u) const noexcept {
+      return u >= &blocks[0].value && u <= &blocks[count - 1].value;
+    }
+
+   private:
+    static constexpr ::std::size_t count = max_integer - min_integer + 2;
+
+    // the table keeps a reference to every unit so none is ever freed,
+    // they are not linked into the heap either
+    immediates() noexcept {
+      for (::std::size_t i = 0; i + 1 < count; ++i) {
+        blocks[i] = counted<unit>{{}, {}, 1, unit{{0, 0}, static_cast<numeric>(min_integer + i)}};
+      }
+      blocks[count - 1] = counted<unit>{{}, {}, 1, unit{{0, 0}, make_list()}};
+
+      for (::std::size_t i = 0; i < count; ++i) {
+        handles[i] = unit_ptr{&blocks[i]};
+      }
+    }
+
+    ::std::array<counted<unit>, count> blocks;
+    ::std::array<unit_ptr, count> handles;
+  };
+
+  inline bool is_immediate(unit_ptr const& u) noexcept {
+    return immediates::get().contains(u.get());
+  }
+
+  inline unit_ptr make_numeric(position const& pos, numeric const n) noexcept {
+    auto const& table = immediates::get();
+    if (table.has_integer(n)) {
+      return table.integer(n);
+    }
+    return make_shared<unit>(pos, n);
+  }
+
+  inline unit_ptr make_nil() noexcept {
+    return immediates::get().nil();
+  }
+
+  // the value of a variable is the unit stored in its binding, errors
+  // about it point at where the variable was referenced instead, the same
+  // goes for immediates since they have no position
+  inline position const& reference_position(
+    unit_ptr const& source, unit_ptr const& value
+  ) noexcept {
+    auto const* sym = ::std::get_if<string>(&source->expr);
+    return (sym && !sym->raw) || is_immediate(value) ? source->pos : value->pos;
+  }
+
+  inline position const& argument_span::pos_of(::std::size_t const i) const noexcept {
+    return call ? reference_position((*call)[i + 1], first[i]) : first[i]->pos;
+  }
+
 }
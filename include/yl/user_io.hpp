@@ -3,15 +3,18 @@
 #include <yl/mem.hpp>
 #include <yl/types.hpp>
 
+#include <optional>
 #include <ostream>
 
 namespace yl {
 
+  // first is the line the input that failed started on
   void print_error(
     ::std::size_t const prompt_offset,
     bool const continuated,
     error_info const& err,
-    ::std::ostream& std_err
+    ::std::ostream& std_err,
+    ::std::size_t const first
   ) noexcept; 
 
   void handle_input(
@@ -30,14 +33,34 @@ namespace yl {
     ::std::ostream& err
   ) noexcept; 
 
+  // the whole text of a file, followed by a null. it is mapped where that
+  // works and stays around until the interpreter exits, the history points
+  // into it
+  struct source_file {
+    char const* text;
+    ::std::size_t size;
+  };
+
+  ::std::optional<source_file> open_source(char const* path) noexcept;
+
+  // runs the forms of a file one after the other, none of them goes into
+  // the readline history
   void handle_file(
-    ::std::ifstream&& file,
+    source_file const& file,
     ::std::ostream& out,
     ::std::ostream& err
   ) noexcept; 
 
+  // evaluates the predef file, or binds the snapshot of it if there is
+  // one that was taken of the same text
   string_representation load_predef(      
     string_representation const& predef = make_string(".predef.yl")
   ) noexcept;
 
+  // evaluates the predef file and snapshots the global environment it
+  // leaves behind next to it, .predef.yl goes to .predef.img
+  string_representation snapshot_predef(
+    string_representation const& predef = make_string(".predef.yl")
+  ) noexcept;
+
 }
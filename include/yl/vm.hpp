@@ -0,0 +1,35 @@
+#pragma once
+
+#include <yl/gc.hpp>
+#include <yl/lexical.hpp>
+#include <yl/types.hpp>
+
+namespace yl::vm {
+
+  // compiled body of a function or of a top level form
+  struct prototype;
+
+  // prototype of a user defined function and what its calls bind into
+  struct closure;
+
+  // compiles body once, calls of the returned function run it on the vm.
+  // bound holds the arguments of a partially applied function
+  function make_function(
+    signature const& sig,
+    unit_ptr const& body,
+    env_node_ptr const& env,
+    function_kind const fk,
+    string_representation const& description,
+    env_ptr const& bound = {}
+  ) noexcept;
+
+  // what make_function was given for cl
+  function_parts parts_of(closure const& cl) noexcept;
+
+  // visits the handles a closure owns for the cycle collector
+  void trace(closure const& cl, tracer& visit) noexcept;
+
+  // compiles and runs a top level form
+  result_type run(unit_ptr const& form, env_node_ptr const& node) noexcept;
+
+}
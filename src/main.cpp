@@ -1,13 +1,16 @@
 #include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
 
+#include <yl/options.hpp>
 #include <yl/user_io.hpp>
 
 #include <readline/readline.h>
 
 #ifdef __unix__
 #include <sys/inotify.h>
+#include <sys/resource.h>
 #include <unistd.h>
 #include <fcntl.h>
 #endif
@@ -17,22 +20,57 @@ int main(int const argc, char const* const* argv) {
 
   ::rl_bind_key('\t', [](int, int) { ::rl_insert_text("  "); return 0;  });
 
+  char const* script = nullptr;
+  bool snapshot = false;
+  for (int i = 1; i < argc; ++i) {
+    if (::std::strcmp(argv[i], "--vm") == 0) {
+      ::yl::options.vm = true;
+    } else if (::std::strcmp(argv[i], "--no-fold") == 0) {
+      ::yl::options.fold = false;
+    } else if (::std::strcmp(argv[i], "--no-gc") == 0) {
+      ::yl::options.collect = false;
+    } else if (::std::strcmp(argv[i], "--huge-pages") == 0) {
+      ::yl::options.huge_pages = true;
+    } else if (::std::strcmp(argv[i], "--share-literals") == 0) {
+      ::yl::options.share_literals = true;
+    } else if (::std::strcmp(argv[i], "--snapshot") == 0) {
+      snapshot = true;
+    } else if (::std::strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) {
+      ::yl::options.max_depth = ::std::strtoull(argv[++i], nullptr, 10);
+    } else {
+      script = argv[i];
+    }
+  }
+
+#ifdef __unix__
+  // leaves a megabyte for whatever is below the evaluation on the stack
+  ::rlimit stack_limit;
+  if (::getrlimit(RLIMIT_STACK, &stack_limit) == 0
+      && stack_limit.rlim_cur != RLIM_INFINITY
+      && stack_limit.rlim_cur > (2 << 20)) {
+    ::yl::options.native_stack = stack_limit.rlim_cur - (1 << 20);
+  }
+#endif
+
+  if (snapshot) {
+    auto const result = ::yl::snapshot_predef();
+    ::std::cout << (result.empty() ? "wrote predef snapshot" : result) << "\n";
+    return result.empty() ? 0 : 1;
+  }
+
   ::std::cout << "yatsukha's lisp" << "\n";
   ::std::cout << "^C to exit, 'help' to get started" << "\n";
 
   auto const predef = ::yl::load_predef();
   ::std::cout << (predef.empty() ? "loaded predef" : predef) << "\n";
 
-  ::std::ifstream input_file;
-
-  if (argc > 1) {
-    input_file = ::std::ifstream{argv[1]};
-    if (input_file.is_open()) {
-      ::std::cout << "interpreting '" << argv[1] << "'" << "\n\n";
-      ::yl::handle_file(::std::move(input_file), ::std::cout, ::std::cerr);
+  if (script) {
+    if (auto const file = ::yl::open_source(script)) {
+      ::std::cout << "interpreting '" << script << "'" << "\n\n";
+      ::yl::handle_file(*file, ::std::cout, ::std::cerr);
     } else {
       ::std::cerr << "unable to open given file for interpretation: "
-                  << argv[1]
+                  << script
                   << "\n"
                   << "exiting"
                   << "\n"; 
@@ -0,0 +1,294 @@
+#include <yl/analyze.hpp>
+#include <yl/arguments.hpp>
+#include <yl/eval.hpp>
+#include <yl/fold.hpp>
+#include <yl/lexical.hpp>
+#include <yl/options.hpp>
+
+#include "builtins.hpp"
+
+namespace yl {
+
+  namespace {
+
+    using executors = seq_representation<executor>;
+
+    bool is_symbol(unit_ptr const& u) noexcept {
+      return is_string(u->expr) && !as_string(u->expr).raw;
+    }
+
+    bool has_comma(list const& ls) noexcept {
+      auto static const comma = intern(make_string(","));
+      for (auto const& u : ls) {
+        if (is_symbol(u) && symbol_of(as_string(u->expr)) == comma) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // global binding of the head of a call, unless a local shadows it
+    unit_ptr const* global_head(list const& ls) noexcept {
+      if (!is_symbol(ls.front()) || is_local(as_string(ls.front()->expr))) {
+        return nullptr;
+      }
+      auto const* bound =
+        global_environment()->curr->find(symbol_of(as_string(ls.front()->expr)));
+      return bound && is_function((*bound)->expr) ? bound : nullptr;
+    }
+
+    bool is_builtin(unit_ptr const& u, function::builtin_type const builtin) noexcept {
+      return as_function(u->expr).builtin == builtin;
+    }
+
+    // same as the list branch of eval, with the head already evaluated
+    result_type apply(
+      unit_ptr const& u,
+      unit_ptr const& front,
+      executors const& args,
+      env_node_ptr const& node,
+      bool const tail
+    ) noexcept {
+      auto const& ls = as_list(u->expr);
+      auto const is_fn = is_function(front->expr);
+
+      if (ls.size() == 1 && !is_fn) {
+        return succeed(front);
+      }
+
+      if (!is_fn) {
+        FAIL_WITH(
+          concat(
+            "Expected a builtin or user defined function, got ",
+            type_of(front->expr),
+            " with value ",
+            front->expr,
+            ", complete expression: ",
+            u->expr,
+            "."
+          ),
+          reference_position(ls.front(), front)
+        );
+      }
+
+      if (native_stack_exhausted()) {
+        FAIL_WITH("Maximum recursion depth exceeded.", u->pos);
+      }
+
+      auto const& fn = as_function(front->expr);
+      auto count = ls.size() - 1;
+      argument_window evaluated{count};
+      list const* call = nullptr;
+
+      if (fn.macro) {
+        ::std::copy(ls.begin() + 1, ls.end(), evaluated.data());
+        auto const kept = force_marked(evaluated.data(), count, node);
+        RETURN_IF_ERROR(kept);
+        count = kept.value();
+      } else {
+        call = &ls;
+        for (::std::size_t i = 0; i < count; ++i) {
+          // calls that looked like macros do not have analyzed arguments
+          auto const arg = args.empty() ? eval(ls[i + 1], node) : args[i](node);
+          RETURN_IF_ERROR(arg);
+          evaluated[i] = arg.value();
+        }
+      }
+
+      // the deferred call outlives the window, so it keeps its own list
+      if (tail && fn.func.template target<user_function>()) {
+        auto deferred = make_list().transient();
+        deferred.push_back(front);
+        for (::std::size_t i = 0; i < count; ++i) {
+          deferred.push_back(evaluated[i]);
+        }
+        return succeed(defer(tail_call{
+          front, ::yl::make_shared<unit>(u->pos, deferred.persistent()), node
+        }));
+      }
+
+      return invoke(
+        front, argument_span{evaluated.data(), count, call}, u->pos, node
+      );
+    }
+
+    executor analyze_literal(unit_ptr const& u) noexcept {
+      return [u](env_node_ptr const&) -> result_type {
+        return succeed(u);
+      };
+    }
+
+    executor analyze_variable(unit_ptr const& u) noexcept {
+      return [u](env_node_ptr const& node) -> result_type {
+        return resolve_symbol(u, node);
+      };
+    }
+
+    executor analyze_if(
+      unit_ptr const& u, unit_ptr const& builtin, executor head, bool const tail
+    ) noexcept {
+      auto const& ls = as_list(u->expr);
+
+      auto condition = analyze(ls[1]);
+      auto then = analyze(ls[2], tail);
+      auto otherwise = ls.size() == 4 ? analyze(ls[3], tail) : executor{};
+      auto const known = options.fold ? fold_condition(ls[1]) : ::std::nullopt;
+
+      return [=](env_node_ptr const& node) -> result_type {
+        auto const front = head(node);
+        RETURN_IF_ERROR(front);
+
+        if (front.value().get() != builtin.get()) {
+          return apply(u, front.value(), make_seq<executor>(), node, tail);
+        }
+
+        // the branch that can not be taken is only kept around for when
+        // the condition stops folding
+        auto const value = known && still_holds(*known, node)
+          ? succeed(known->value)
+          : condition(node);
+        RETURN_IF_ERROR(value);
+
+        if (!is_numeric(value.value()->expr)) {
+          FAIL_WITH("Expected a numeric value.", as_list(u->expr)[1]->pos);
+        }
+
+        if (as_numeric(value.value()->expr)) {
+          return then(node);
+        }
+
+        if (otherwise) {
+          return otherwise(node);
+        }
+
+        SUCCEED_WITH(u->pos, make_list());
+      };
+    }
+
+    executor analyze_do(
+      unit_ptr const& u, unit_ptr const& builtin, executor head, bool const tail
+    ) noexcept {
+      auto const& ls = as_list(u->expr);
+
+      auto forms = make_seq<executor>();
+      forms.reserve(ls.size() - 1);
+      for (::std::size_t i = 1; i < ls.size(); ++i) {
+        forms.push_back(analyze(ls[i], tail && i == ls.size() - 1));
+      }
+
+      return [=](env_node_ptr const& node) -> result_type {
+        auto const front = head(node);
+        RETURN_IF_ERROR(front);
+
+        if (front.value().get() != builtin.get()) {
+          return apply(u, front.value(), make_seq<executor>(), node, tail);
+        }
+
+        for (::std::size_t i = 0; i + 1 < forms.size(); ++i) {
+          auto const result = forms[i](node);
+          RETURN_IF_ERROR(result);
+        }
+
+        return forms.back()(node);
+      };
+    }
+
+    executor analyze_folded(
+      folded known, executor fallback
+    ) noexcept {
+      return [known = ::std::move(known), fallback = ::std::move(fallback)](
+        env_node_ptr const& node
+      ) -> result_type {
+        if (still_holds(known, node)) {
+          return succeed(known.value);
+        }
+        return fallback(node);
+      };
+    }
+
+    executor analyze_call(unit_ptr const& u, bool const tail) noexcept {
+      auto const& ls = as_list(u->expr);
+      auto const* global = global_head(ls);
+      auto head = analyze(ls.front());
+
+      if (global && as_function((*global)->expr).macro) {
+        if (is_builtin(*global, &if_m)
+            && ls.size() >= 3 && ls.size() <= 4 && !has_comma(ls)) {
+          return analyze_if(u, *global, ::std::move(head), tail);
+        }
+
+        if (is_builtin(*global, &do_m) && ls.size() >= 2 && !has_comma(ls)) {
+          return analyze_do(u, *global, ::std::move(head), tail);
+        }
+
+        // macro arguments are data, eval handles them in the rare case
+        // that the head turns out to be a regular function
+        return [u, head = ::std::move(head), tail](
+          env_node_ptr const& node
+        ) -> result_type {
+          auto const front = head(node);
+          RETURN_IF_ERROR(front);
+          return apply(u, front.value(), make_seq<executor>(), node, tail);
+        };
+      }
+
+      auto args = make_seq<executor>();
+      args.reserve(ls.size() - 1);
+      for (::std::size_t i = 1; i < ls.size(); ++i) {
+        args.push_back(analyze(ls[i]));
+      }
+
+      return [u, head = ::std::move(head), args = ::std::move(args), tail](
+        env_node_ptr const& node
+      ) -> result_type {
+        auto const front = head(node);
+        RETURN_IF_ERROR(front);
+        return apply(u, front.value(), args, node, tail);
+      };
+    }
+
+    // at most one call is deferred at a time, the function whose body
+    // deferred it takes it before doing anything else
+    tail_call& deferred() noexcept {
+      static tail_call call;
+      return call;
+    }
+
+    unit_ptr const& marker() noexcept {
+      static auto const u = ::yl::make_shared<unit>(position{0, 0}, make_list());
+      return u;
+    }
+
+  }
+
+  unit_ptr const& defer(tail_call call) noexcept {
+    deferred() = ::std::move(call);
+    return marker();
+  }
+
+  bool is_deferred(unit_ptr const& u) noexcept {
+    return u.get() == marker().get();
+  }
+
+  tail_call take_deferred() noexcept {
+    return ::std::move(deferred());
+  }
+
+  executor analyze(unit_ptr const& u, bool const tail) noexcept {
+    if (is_list(u->expr) && !as_list(u->expr).empty()) {
+      if (options.fold) {
+        if (auto known = fold(u)) {
+          return analyze_folded(::std::move(*known), analyze_call(u, tail));
+        }
+      }
+      return analyze_call(u, tail);
+    }
+
+    if (is_symbol(u)) {
+      return analyze_variable(u);
+    }
+
+    return analyze_literal(u);
+  }
+
+}
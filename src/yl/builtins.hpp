@@ -6,17 +6,24 @@
 #include <iostream>
 #include <stdexcept>
 
+#include <yl/analyze.hpp>
+#include <yl/arguments.hpp>
 #include <yl/mem.hpp>
 #include <yl/util.hpp>
 #include <yl/types.hpp>
 #include <yl/eval.hpp>
+#include <yl/image.hpp>
+#include <yl/lexical.hpp>
+#include <yl/literals.hpp>
+#include <yl/options.hpp>
 #include <yl/type_operations.hpp>
+#include <yl/vm.hpp>
 
 namespace yl {
 
-#define ASSERT_ARG_COUNT(u, eq) \
-  if (!(as_list(u->expr).size() - 1 eq)) { \
-    FAIL_WITH("Argument count must be " #eq ".", u->pos) \
+#define ASSERT_ARG_COUNT(args, eq) \
+  if (!(args.size() eq)) { \
+    FAIL_WITH("Argument count must be " #eq ".", pos) \
   }
 
   inline bool is_raw(unit_ptr const& u) noexcept {
@@ -31,18 +38,18 @@ namespace yl {
     });  \
   }
 
-#define LIST_OR_ERROR(unit_ptr) \
+#define LIST_OR_ERROR(unit_ptr, pos) \
   if (!is_list(unit_ptr->expr)) {\
     return fail(error_info{ \
       concat("Expected a Q expression got ", type_of(unit_ptr->expr), ": ", unit_ptr->expr), \
-       unit_ptr->pos \
+       pos \
     });  \
   }
 
-#define RAW_OR_ERROR(unit_ptr) \
+#define RAW_OR_ERROR(unit_ptr, pos) \
   if (!is_raw(unit_ptr)) { \
     FAIL_WITH(concat("Expected a raw string got ", type_of(unit_ptr->expr), "."), \
-              unit_ptr->pos); \
+              pos); \
   }
 
   inline either<error_info, numeric> numeric_or_error(unit_ptr const& u) noexcept {
@@ -61,18 +68,17 @@ namespace yl {
   }
 
 #define ARITHMETIC_OPERATOR(name, operation) \
-  inline result_type name##_m(unit_ptr const& u, env_node_ptr&) noexcept { \
-    auto const& args = as_list(u->expr); \
-    ASSERT_ARG_COUNT(u, >= 1); \
-    auto first = cast_numeric(args[1]); \
+  inline result_type name##_m(argument_span const& args, position const& pos, env_node_ptr const&) noexcept { \
+    ASSERT_ARG_COUNT(args, >= 1); \
+    auto first = cast_numeric(args[0], args.pos_of(0)); \
     RETURN_IF_ERROR(first); \
     numeric result = first.value(); \
-    for (::std::size_t idx = 2; idx < args.size(); ++idx) { \
-      auto noe = cast_numeric(args[idx]); \
+    for (::std::size_t idx = 1; idx < args.size(); ++idx) { \
+      auto noe = cast_numeric(args[idx], args.pos_of(idx)); \
       RETURN_IF_ERROR(noe); \
       result operation##= noe.value(); \
     } \
-    SUCCEED_WITH(u->pos, result); \
+    SUCCEED_WITH(pos, result); \
   }
 
   ARITHMETIC_OPERATOR(add, +);
@@ -88,53 +94,46 @@ namespace yl {
   ARITHMETIC_OPERATOR(shl, <<);
   ARITHMETIC_OPERATOR(shr, >>);
 
-  inline result_type quote_m(unit_ptr const& u, env_node_ptr&) noexcept {
-    ASSERT_ARG_COUNT(u, == 1);
-    return succeed(as_list(u->expr)[1]);
+  inline result_type quote_m(argument_span const& args, position const& pos, env_node_ptr const&) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
+    return succeed(args[0]);
   }
 
-  inline result_type eval_m(unit_ptr const& u, env_node_ptr& node) noexcept {
-    auto const& args = as_list(u->expr);
-
-    ASSERT_ARG_COUNT(u, == 1);
-    return eval(args[1], node);
+  inline result_type eval_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
+    return eval(args[0], node);
   }
 
-  inline result_type list_m(unit_ptr const& u, env_node_ptr& node) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, >= 1);
-    SUCCEED_WITH(u->pos, (make_seq<unit_ptr>(args.begin() + 1, args.end())));
+  inline result_type list_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
+    ASSERT_ARG_COUNT(args, >= 1);
+    SUCCEED_WITH(pos, (make_list(args.begin(), args.end())));
   }
 
-  inline result_type echo_m(unit_ptr const& u, env_node_ptr& node) noexcept {
-    ASSERT_ARG_COUNT(u, == 1);
-    ::std::cout << as_list(u->expr)[1]->expr << "\n";
-    SUCCEED_WITH(u->pos, make_list());
+  inline result_type echo_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
+    ::std::cout << args[0]->expr << "\n";
+    SUCCEED_WITH(pos, make_list());
   }
 
 #define SINGLE_LIST_BUILTIN(name, q_expr, r_string) \
-  inline result_type name##_m(unit_ptr const& u, env_node_ptr& node) noexcept { \
-    auto const& args = as_list(u->expr); \
-    ASSERT_ARG_COUNT(u, == 1); \
-    bool is_ls = is_list(args[1]->expr); \
-    if (!is_ls && !is_raw(args[1])) { \
+  inline result_type name##_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept { \
+    ASSERT_ARG_COUNT(args, == 1); \
+    bool is_ls = is_list(args[0]->expr); \
+    if (!is_ls && !is_raw(args[0])) { \
       FAIL_WITH("Expected a list or a raw string as an argument.", \
-                args[1]->pos); \
+                args.pos_of(0)); \
     } \
-    return is_ls ? q_expr(args[1]) : r_string(args[1]); \
+    return is_ls ? q_expr(args[0]) : r_string(args[0]); \
   }
 
   SINGLE_LIST_BUILTIN(
     head,
-    [](auto const& u) { 
+    [](auto const& u) -> result_type {
       auto const& ls = as_list(u->expr);
-      auto const empty = ls.empty();
-      SUCCEED_WITH(
-        empty ? u->pos : ls.front()->pos,
-          empty 
-            ? expression{make_list()}
-            : ls[0]->expr
-      );
+      if (ls.empty()) {
+        SUCCEED_WITH(u->pos, make_list());
+      }
+      return succeed(ls.front());
     },
     [](auto const& u) {
       auto const& str = as_string(u->expr).str;
@@ -153,15 +152,7 @@ namespace yl {
   SINGLE_LIST_BUILTIN(
     tail,
     [](auto const& u) {
-      auto const& ls = as_list(u->expr);
-      SUCCEED_WITH(u->pos,
-        make_seq<unit_ptr>(
-          ls.begin() + 1, 
-          ls.empty() 
-            ? ls.begin() + 1
-            : ls.end()
-        )
-      );
+      SUCCEED_WITH(u->pos, reuse<list>(u).drop(1));
     },
     [](auto const& u) {
       auto const& str = as_string(u->expr).str;
@@ -180,12 +171,12 @@ namespace yl {
   
   SINGLE_LIST_BUILTIN(
     last,
-    [](auto const& u) {
+    [](auto const& u) -> result_type {
       auto const& ls = as_list(u->expr);
-      auto const empty = ls.empty();
-      SUCCEED_WITH(empty ? u->pos : ls.back()->pos,
-        empty ? expression{make_list()} : ls.back()->expr
-      );
+      if (ls.empty()) {
+        SUCCEED_WITH(u->pos, make_list());
+      }
+      return succeed(ls.back());
     },
     [](auto const& u) {
       auto const& str = as_string(u->expr).str;
@@ -205,14 +196,9 @@ namespace yl {
   SINGLE_LIST_BUILTIN(
     init,
     [](auto const& u) {
-      auto const& ls = as_list(u->expr);
-      SUCCEED_WITH(
-        u->pos,
-          make_seq<unit_ptr>(
-            ls.begin(), 
-            ls.empty() ? ls.begin() : ls.end() - 1
-          )
-      );
+      auto ls = reuse<list>(u);
+      auto const size = ls.size();
+      SUCCEED_WITH(u->pos, ::std::move(ls).take(size ? size - 1 : 0));
     },
     [](auto const& u) {
       auto const& str = as_string(u->expr).str;
@@ -228,92 +214,87 @@ namespace yl {
     }
   );
 
-  inline result_type join_m(unit_ptr const& u, env_node_ptr& node) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, >= 1);
+  inline result_type join_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
+    ASSERT_ARG_COUNT(args, >= 1);
 
     bool is_ls;
 
-    if (!(is_ls = is_list(args[1]->expr)) && !is_raw(args[1])) {
+    if (!(is_ls = is_list(args[0]->expr)) && !is_raw(args[0])) {
       FAIL_WITH("Join expects a list expression or a raw string as an argument.", 
-                args[1]->pos);
+                args.pos_of(0));
     }
 
     if (is_ls) {
-      auto ret = make_list();
+      auto ret = reuse<list>(args[0]);
       for (::std::size_t i = 1; i < args.size(); ++i) {
-        auto const& other = as_list(args[i]->expr);
-        ret.insert(ret.end(), 
-                            other.begin(), other.end());
+        ret = ::std::move(ret) + reuse<list>(args[i]);
       }
-      SUCCEED_WITH(u->pos, ::std::move(ret));
+      SUCCEED_WITH(pos, ::std::move(ret));
     }
 
-    string str;
-    str.raw = true;
+    auto str = reuse<string>(args[0]);
     for (::std::size_t i = 1; i < args.size(); ++i) {
-      RAW_OR_ERROR(args[i]);
+      RAW_OR_ERROR(args[i], args.pos_of(i));
       str.str += as_string(args[i]->expr).str;
     }
 
-    SUCCEED_WITH(u->pos, std::move(str));
+    SUCCEED_WITH(pos, std::move(str));
   }
 
-  inline result_type cons_m(unit_ptr const& u, env_node_ptr& node) noexcept {
-    auto const& args = as_list(u->expr);
+  inline result_type cons_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
+    ASSERT_ARG_COUNT(args, == 2);
 
-    ASSERT_ARG_COUNT(u, == 2);
-    return cast_list(args[2]).collect_flat(
-      [&](auto&&) {
-        return cast_hash_map(args[2]).collect_flat(
-          [&](auto&&) { 
-            FAIL_WITH(
-              concat(
-                "Expected Q expression or hash_map, got: ", 
-                type_of(args[2]->expr), " ", args[2]->expr), 
-              args[2]->pos); 
-          },
-          [&](auto&& map) {
-            return cast_list(args[1]).collect_flat(
-              fail_functor,
-              [&](auto&& q) -> result_type {
-                if (q.size() != 2) {
-                  FAIL_WITH("Expected a Q expression with two elements.", args[1]->pos);
-                }
-                SUCCEED_WITH(unit{
-                  u->pos,
-                  expression{map.insert({q[0], q[1]})}});
-              }
-            );
-          }
-        );
-      },
-      [&](auto other) {
-        other.insert(other.begin(), args[1]);
-        SUCCEED_WITH(u->pos, ::std::move(other));
-      }
-    );
+    if (is_list(args[1]->expr)) {
+      SUCCEED_WITH(pos, make_list().push_back(args[0]) + reuse<list>(args[1]));
+    }
+
+    if (!is_hash_map(args[1]->expr)) {
+      FAIL_WITH(
+        concat(
+          "Expected Q expression or hash_map, got: ", 
+          type_of(args[1]->expr), " ", args[1]->expr), 
+        args.pos_of(1)); 
+    }
+
+    // the map is not copied first, so that a map only the argument holds
+    // is updated in place
+    auto const pair = cast_list(args[0], args.pos_of(0));
+    RETURN_IF_ERROR(pair);
+
+    auto const& q = pair.value();
+    if (q.size() != 2) {
+      FAIL_WITH("Expected a Q expression with two elements.", args.pos_of(0));
+    }
+    SUCCEED_WITH(pos, (reuse<hash_map>(args[1]).insert({q[0], q[1]})));
   }
 
-  inline result_type at_m(unit_ptr const& u, env_node_ptr& node) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, == 2);
+  inline result_type at_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
+    ASSERT_ARG_COUNT(args, == 2);
 
-    auto& seq = args[2];
-    auto& idx = args[1];
+    auto& seq = args[1];
+    auto& idx = args[0];
+
+    // looked up directly, without formatting the map into a cast error
+    if (is_hash_map(seq->expr)) {
+      auto const* found = as_hash_map(seq->expr).find(idx);
+      if (!found) {
+        SUCCEED_WITH(pos, make_list());
+      }
+      return succeed(*found);
+    }
 
     auto const err = fail(error_info{
       .error_message = concat(
         "Expected Q expr, raw string or hash map, got: ", 
-        type_of(args[2]->expr)),
-      .pos = args[2]->pos
+        type_of(args[1]->expr)),
+      .pos = args.pos_of(1)
     });
 
     return cast_qr(seq).collect_flat(
       [&](auto&&) {
-        return cast_hash_map(args[2]).collect_flat(
+        return cast_hash_map(args[1], args.pos_of(1)).collect_flat(
           [err](auto&&) { return err; },
-          [&idx, pos = u->pos](auto&& map) -> result_type { 
+          [&idx, &pos](auto&& map) -> result_type { 
             if (!map.count(idx)) {
               SUCCEED_WITH(pos, make_list());  
             }
@@ -323,17 +304,17 @@ namespace yl {
       },
 
       [&](auto&& ls_or_str) {
-        return cast_numeric(args[1]).flat_map(
+        return cast_numeric(args[0], args.pos_of(0)).flat_map(
           [&](auto&& num_idx) -> result_type {
             if (num_idx < 0 || static_cast<::std::size_t>(num_idx) >= len(seq)) {
               FAIL_WITH(
                 concat(num_idx, " is out of bounds for size ", len(seq), "."), 
-                idx->pos);
+                args.pos_of(0));
             }
             return ls_or_str.collect_flat(
               [num_idx](auto&& ls) { return succeed(ls[num_idx]); },
               [&](auto&& str) { SUCCEED_WITH(
-                u->pos, 
+                pos, 
                 (string{make_string(str.str.substr(num_idx, 1)), true})); 
               }
             );
@@ -343,58 +324,48 @@ namespace yl {
     );
   }
 
-  inline result_type len_m(unit_ptr const& u, env_node_ptr& node) noexcept {
-    auto const& args = as_list(u->expr);
-
-    ASSERT_ARG_COUNT(u, == 1);
+  inline result_type len_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
 
-    if (is_list(args[1]->expr)) {
-      SUCCEED_WITH(u->pos, numeric(as_list(args[1]->expr).size()));
+    if (is_list(args[0]->expr)) {
+      SUCCEED_WITH(pos, numeric(as_list(args[0]->expr).size()));
     }
 
-    if (is_raw(args[1])) {
-      SUCCEED_WITH(u->pos, numeric(as_string(args[1]->expr).str.size()));
+    if (is_raw(args[0])) {
+      SUCCEED_WITH(pos, numeric(as_string(args[0]->expr).str.size()));
     }
 
-    if (is_hash_map(args[1]->expr)) {
-      SUCCEED_WITH(u->pos, numeric(as_hash_map(args[1]->expr).size()));
+    if (is_hash_map(args[0]->expr)) {
+      SUCCEED_WITH(pos, numeric(as_hash_map(args[0]->expr).size()));
     }
 
     FAIL_WITH(
       "Expected a Q expression, hash map, or raw string.", 
-      args[1]->pos);
+      args.pos_of(0));
   }
 
-  inline result_type assignment_m(unit_ptr const& u, env_node_ptr& node) noexcept {
-    auto const& args = as_list(u->expr);
-  
-    ASSERT_ARG_COUNT(u, >= 2);
+  inline result_type assignment_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
+    ASSERT_ARG_COUNT(args, >= 2);
 
-    bool is_ls = is_list(args[1]->expr);
-    auto ls = make_list();
+    bool is_ls = is_list(args[0]->expr);
 
-    if (!is_ls) {
-      if (is_raw(args[1])) {
-        FAIL_WITH("Expected a symbol.", args[1]->pos);
-      }
-      ls.push_back(args[1]);
+    if (!is_ls && is_raw(args[0])) {
+      FAIL_WITH("Expected a symbol.", args.pos_of(0));
     }
 
-    auto const* arguments_ptr = &ls;
-    if (is_ls) {
-      arguments_ptr = &as_list(args[1]->expr);
-    }
-    auto const& arguments = *arguments_ptr;
+    auto const arguments = is_ls
+      ? as_list(args[0]->expr)
+      : make_list().push_back(args[0]);
 
-    auto g_env = global_environment();
+    auto const global = node->curr == global_frame();
 
-    if (arguments.size() != args.size() - 2) {
+    if (arguments.size() != args.size() - 1) {
       FAIL_WITH(
         concat(
           "Differing length of arguments and corresponding assignments: ",
-          arguments.size(), args.size() - 2
+          arguments.size(), args.size() - 1
         ),
-        u->pos
+        pos
       );
     }
 
@@ -404,18 +375,22 @@ namespace yl {
         FAIL_WITH("Unexpected non-symbol in the argument list.", 
                   arguments[i]->pos);
       }
-      auto new_value = eval(args[2 + i], node);
+      auto new_value = eval(args[1 + i], node);
       RETURN_IF_ERROR(new_value);
-      (*node->curr)[as_string(arguments[i]->expr).str] = new_value.value();
+      node->curr->assign(
+        symbol_of(as_string(arguments[i]->expr)), new_value.value());
+      if (global) {
+        ++global_version;
+      }
     }
 
-    SUCCEED_WITH(u->pos, (make_list()));
+    SUCCEED_WITH(pos, (make_list()));
   }
  
-  inline result_type def_m(unit_ptr const& u, env_node_ptr& node) noexcept {
+  inline result_type def_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
     auto ptr = global_environment();
     ptr->prev = node;
-    return assignment_m(u, ptr);
+    return assignment_m(args, pos, ptr);
   }
 
 
@@ -423,11 +398,14 @@ namespace yl {
 
     inline result_type decompose_impl(unit_ptr const& sym, 
                                       unit_ptr const& expr,
-                                      env_node_ptr& node) noexcept {
+                                      env_node_ptr const& node) noexcept {
       if (is_string(sym->expr) && !as_string(sym->expr).raw) {
-        (*node->curr)[as_string(sym->expr).str] = expr;
+        node->curr->assign(symbol_of(as_string(sym->expr)), expr);
+        if (node->curr == global_frame()) {
+          ++global_version;
+        }
       } else if (is_list(sym->expr)) {
-        LIST_OR_ERROR(expr);
+        LIST_OR_ERROR(expr, expr->pos);
 
         auto const& syms = as_list(sym->expr);
         auto const& sube = as_list(expr->expr);
@@ -448,142 +426,124 @@ namespace yl {
 
   }
 
-  inline result_type decompose_m(unit_ptr const& u, env_node_ptr& node) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, == 2);
+  inline result_type decompose_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
+    ASSERT_ARG_COUNT(args, == 2);
 
-    auto const evald = eval(args[2], node);
+    auto const evald = eval(args[1], node);
     RETURN_IF_ERROR(evald);
     
-    RETURN_IF_ERROR(detail::decompose_impl(args[1], evald.value(), node));
-    SUCCEED_WITH(u->pos, (make_list()));
+    RETURN_IF_ERROR(detail::decompose_impl(args[0], evald.value(), node));
+    SUCCEED_WITH(pos, (make_list()));
   }
 
-  namespace detail {
-
-    enum class function_kind {
-      regular,
-      macro,
-      syntax
-    };
+  // a call runs the body and then every call its body deferred, so tail
+  // calls do not grow the stack
+  struct user_function {
+    signature sig;
+    unit_ptr body;
+    executor run;
+    env_node_ptr closure;
+    function_kind fk;
+    env_ptr bound;
+
+    result_type step(
+      argument_span const& args, position const& pos, env_node_ptr const& syntax_env
+    ) const noexcept;
+
+    result_type step(unit_ptr const& u, env_node_ptr const& syntax_env) const noexcept {
+      auto const& arguments = as_list(u->expr);
+      auto const count = arguments.size() - 1;
 
-  }
+      argument_window values{count};
+      ::std::copy(arguments.begin() + 1, arguments.end(), values.data());
+      return step(argument_span{values.data(), count}, u->pos, syntax_env);
+    }
 
-  inline function::type create_function(
-    bool const variadic, bool const unused,
-    list const& arglist, unit_ptr const& body,
-    env_node_ptr closure,
-    detail::function_kind const fk,
-    env_ptr self_env = {}
-  ) noexcept {
-    return [=](unit_ptr const& u, env_node_ptr& syntax_env) mutable -> result_type {
-      auto const& arguments = as_list(u->expr);
-      if (!variadic && arglist.size() < arguments.size() - 1) {
-        FAIL_WITH(
-          concat(
-            "Excess arguments, expected ",
-            arglist.size(),
-            ", got ",
-            arguments.size() - 1,
-            "."
-          ),
-          u->pos
-        );
-      }
+    result_type operator()(unit_ptr const& u, env_node_ptr const& syntax_env) const noexcept {
+      return finish(step(u, syntax_env));
+    }
 
-      bool partial = !variadic && arglist.size() > arguments.size() - 1;
+    // same as a call with the whole call as a list, without building it
+    result_type operator()(
+      argument_span const& args, position const& pos, env_node_ptr const& syntax_env
+    ) const noexcept {
+      return finish(step(args, pos, syntax_env));
+    }
 
-      // TODO: does it work without this?
-      // also evaluate the line above
-      if (variadic 
-          && arglist.size() > arguments.size() + !unused) {
-        FAIL_WITH(
-          "Not enough values to assign to non-variadic parameters.",
-          u->pos
-        );
+    static result_type finish(result_type result) noexcept {
+      while (result && is_deferred(result.value())) {
+        auto const next = take_deferred();
+        result = as_function(next.callee->expr).func
+          .template target<user_function>()->step(next.call, next.env);
       }
 
-      // 
-      self_env = self_env ?: make_shared<environment>();
+      return result;
+    }
+  };
 
-      for (::std::size_t i = 0; 
-           i != (arglist.size() ? arguments.size() - 1 : 0); ++i) {
-        auto sym = as_string(arglist[i]->expr);
-        if (sym.str[0] == '&') {
-          if (unused) {
-            break;
-          }
-        
-          (*self_env)[as_string(arglist[i + 1]->expr).str] = 
-            ::yl::make_shared<unit>(
-              arguments[i + 1]->pos,
-              make_seq<unit_ptr>(arguments.begin() + i + 1, arguments.end())
-            );
-          break;
-        }
+  inline function::type create_function(
+    signature const& sig,
+    unit_ptr const& body,
+    executor const& run,
+    env_node_ptr closure,
+    function_kind const fk,
+    env_ptr bound = {}
+  ) noexcept {
+    return user_function{sig, body, run, ::std::move(closure), fk, ::std::move(bound)};
+  }
 
-        (*self_env)[as_string(arglist[i]->expr).str] = 
-          arguments[i + 1]; // fix eval with respect to macros
-      }
+  inline result_type user_function::step(
+    argument_span const& args, position const& pos, env_node_ptr const& syntax_env
+  ) const noexcept {
+    auto const count = args.size();
 
-      if (arguments.size() - 1 < arglist.size() - variadic && !unused) {
-        (*self_env)[as_string(arglist.back()->expr).str] =
-          ::yl::make_shared<unit>(u->pos, make_list());
-      }
+    auto const frame = 
+      bind_arguments(sig, args.begin(), count, pos, bound);
+    RETURN_IF_ERROR(frame);
 
-      if (partial) {
-        SUCCEED_WITH(body->pos, (function{
-          .description = make_string("User defined partially evaluated function."),
-          .func = [=](unit_ptr const& nested_u, env_node_ptr& nested_env) -> result_type {
-            return create_function(
-              false, false, 
-              make_seq<unit_ptr>(
-                arglist.begin() + arguments.size() - 1,
-                arglist.end()
-              ),
-              body,
-              fk == detail::function_kind::syntax ? syntax_env : closure,
-              fk,
-              self_env
-            )(nested_u, nested_env);
-          }})
-        );
-      }
+    auto const& env = fk == function_kind::syntax ? syntax_env : closure;
 
-      return eval(
-        body, 
-        make_shared<env_node>(env_node{
-          .curr = self_env,
-          .prev = fk == detail::function_kind::syntax ? syntax_env : closure
-        }) 
+    if (is_partial(sig, count)) {
+      SUCCEED_WITH(body->pos, (function{
+        .description = make_string("User defined partially evaluated function."),
+        .func = create_function(
+          partial_signature(sig, count), body, run, env, fk, frame.value()
+        )})
       );
-    };
+    }
+
+    return run(
+      make_shared<env_node>(env_node{
+        .curr = frame.value(),
+        .prev = env
+      }) 
+    );
   }
 
   inline result_type create_function_facade(
-    unit_ptr const& u, env_node_ptr& node,
-    detail::function_kind const fk
+    argument_span const& args,
+    position const& pos,
+    env_node_ptr const& node,
+    function_kind const fk
   ) noexcept {
-    auto const& args = as_list(u->expr);
-
-    ASSERT_ARG_COUNT(u, >= 2);
-    ASSERT_ARG_COUNT(u, <= 3);
+    ASSERT_ARG_COUNT(args, >= 2);
+    ASSERT_ARG_COUNT(args, <= 3);
 
-    LIST_OR_ERROR(args[1]);
+    LIST_OR_ERROR(args[0], args.pos_of(0));
 
     auto doc_string = make_string("User defined function.");
 
-    if (args.size() == 4) {
-      LIST_OR_ERROR(args[3]);
-      if (!is_string(args[2]->expr) || !as_string(args[2]->expr).raw) {
-        FAIL_WITH("Expected a raw doc-string.", args[2]->pos);
+    if (args.size() == 3) {
+      LIST_OR_ERROR(args[2], args.pos_of(2));
+      if (!is_string(args[1]->expr) || !as_string(args[1]->expr).raw) {
+        FAIL_WITH("Expected a raw doc-string.", args.pos_of(1));
       }
-      doc_string = as_string(args[2]->expr).str;
+      doc_string = as_string(args[1]->expr).str;
     } else {
-      LIST_OR_ERROR(args[2]);
+      LIST_OR_ERROR(args[1], args.pos_of(1));
     }
 
-    auto const& arglist = as_list(args[1]->expr);
+    auto const& arglist = as_list(args[0]->expr);
 
     bool variadic = arglist.size() == 0;
     bool unused   = variadic;
@@ -611,38 +571,50 @@ namespace yl {
       }
     }
 
-    auto const& body = args.size() == 4 ? args[3] : args[2];
+    auto const& body = args.size() == 3 ? args[2] : args[1];
+
+    auto const layout = make_layout(arglist, body);
+
+    // syntax macros see the environment of the call site, which is not
+    // known until they are called
+    if (fk != function_kind::syntax) {
+      resolve_lexical(body, *layout, node);
+    }
+
+    auto const sig = signature{variadic, unused, arglist, 0, layout};
+
+    if (options.vm) {
+      SUCCEED_WITH(pos, vm::make_function(sig, body, node, fk, doc_string));
+    }
 
     SUCCEED_WITH(
-      u->pos,
+      pos,
       (function{
         .description = ::std::move(doc_string),
-        .func = create_function(variadic, unused, arglist, body, node, fk),
-        .macro = fk != detail::function_kind::regular
+        .func = create_function(sig, body, analyze(body, true), node, fk),
+        .macro = fk != function_kind::regular
       })
     );
   }
 
-  inline result_type lambda_m(unit_ptr const& u, env_node_ptr& node) noexcept {
-    return create_function_facade(u, node, detail::function_kind::regular);
+  inline result_type lambda_m(argument_span const& args, position const& pos, env_node_ptr const& node) noexcept {
+    return create_function_facade(args, pos, node, function_kind::regular);
   }
 
-  inline result_type macro_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    return create_function_facade(u, env, detail::function_kind::macro);
+  inline result_type macro_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    return create_function_facade(args, pos, env, function_kind::macro);
   }
 
-  inline result_type syntax_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    return create_function_facade(u, env, detail::function_kind::syntax);
+  inline result_type syntax_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    return create_function_facade(args, pos, env, function_kind::syntax);
   }
 
-  inline result_type help_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto const& args = as_list(u->expr);
-    
-    ASSERT_ARG_COUNT(u, <= 1);
+  inline result_type help_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, <= 1);
 
     string s{make_string("\n"), true};
 
-    if (args.size() == 1) {
+    if (args.empty()) {
       s.str +=
         "  This is a lisp like intepreted language.\n"
         "  There are only 4 types: numeric, symbol, function and list.\n"
@@ -666,24 +638,24 @@ namespace yl {
         "\n"
         "  Enter 'help symbol' to get information about a symbol.\n"
         "  Symbols currently available for inspection:\n";
-      for (auto&& sym : *env->curr) {
+      env->curr->for_each([&s](symbol_id const id, unit_ptr const&) {
         s.str += "    ";
-        s.str += sym.first;
+        s.str += symbol_name(id);
         s.str += "\n";
-      }
+      });
 
-      SUCCEED_WITH(u->pos, ::std::move(s));
+      SUCCEED_WITH(pos, ::std::move(s));
     }
 
     expression expr;
 
-    if (is_string(args[1]->expr)) {
-      auto resolved = resolve_symbol(args[1], env); 
+    if (is_string(args[0]->expr)) {
+      auto resolved = resolve_symbol(args[0], env); 
       RETURN_IF_ERROR(resolved);
 
-      expr = (*env->curr)[as_string(resolved.value()->expr).str]->expr;
+      expr = resolved.value()->expr;
     } else {
-      expr = args[1]->expr;
+      expr = args[0]->expr;
     }
 
     s.str += type_of(expr);
@@ -693,7 +665,7 @@ namespace yl {
     ss << expr << "\n";
     s.str += ss.str();
     
-    SUCCEED_WITH(u->pos, ::std::move(s));
+    SUCCEED_WITH(pos, ::std::move(s));
   }
 
   /*
@@ -702,35 +674,33 @@ namespace yl {
    *
    */
 
-  inline result_type equal_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, == 2);
-    SUCCEED_WITH(u->pos, args[1] == args[2]);
+  inline result_type equal_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, == 2);
+    SUCCEED_WITH(pos, args[0] == args[1]);
   }
 
-  inline result_type not_equal_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto ret = equal_m(u, env);
+  inline result_type not_equal_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    auto ret = equal_m(args, pos, env);
     RETURN_IF_ERROR(ret);
-    SUCCEED_WITH(u->pos, !as_numeric(ret.value()->expr));
+    SUCCEED_WITH(pos, !as_numeric(ret.value()->expr));
   }
 
 #define SIMPLE_ORDERING(name, op) \
-  inline result_type name##_m(unit_ptr const& u, env_node_ptr& env) noexcept { \
-    auto const& args = as_list(u->expr); \
-    ASSERT_ARG_COUNT(u, == 2); \
-    if (args[1]->expr.index() != args[2]->expr.index()) { \
-      FAIL_WITH("Expected two arguments of same type.", args[1]->pos);  \
+  inline result_type name##_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept { \
+    ASSERT_ARG_COUNT(args, == 2); \
+    if (args[0]->expr.index() != args[1]->expr.index()) { \
+      FAIL_WITH("Expected two arguments of same type.", args.pos_of(0));  \
     } \
-    if (is_numeric(args[1]->expr)) { \
-      SUCCEED_WITH(u->pos, static_cast<numeric>( \
-        as_numeric(args[1]->expr) op as_numeric(args[2]->expr) \
+    if (is_numeric(args[0]->expr)) { \
+      SUCCEED_WITH(pos, static_cast<numeric>( \
+        as_numeric(args[0]->expr) op as_numeric(args[1]->expr) \
       )); \
-    } else if (is_raw(args[1])) { \
-      SUCCEED_WITH(u->pos, static_cast<numeric>( \
-        as_string(args[1]->expr).str op as_string(args[2]->expr).str \
+    } else if (is_raw(args[0])) { \
+      SUCCEED_WITH(pos, static_cast<numeric>( \
+        as_string(args[0]->expr).str op as_string(args[1]->expr).str \
       )); \
     } \
-    FAIL_WITH("Expected either raw strings or numbers as an argument.", args[1]->pos); \
+    FAIL_WITH("Expected either raw strings or numbers as an argument.", args.pos_of(0)); \
   }
 
   SIMPLE_ORDERING(less_than, <);
@@ -738,29 +708,27 @@ namespace yl {
   SIMPLE_ORDERING(less_or_equal, <=);
   SIMPLE_ORDERING(greater_or_equal, >=);
 
-  inline result_type if_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto const& args = as_list(u->expr);
-
-    ASSERT_ARG_COUNT(u, >= 2);
-    ASSERT_ARG_COUNT(u, <= 3);
+  inline result_type if_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, >= 2);
+    ASSERT_ARG_COUNT(args, <= 3);
 
-    bool has_else = args.size() == 4;
+    bool has_else = args.size() == 3;
     
-    auto const condition = eval(args[1], env);
+    auto const condition = eval(args[0], env);
     RETURN_IF_ERROR(condition);
     auto const& inner = condition.value();
 
     if (!is_numeric(inner->expr)) {
-      FAIL_WITH("Expected a numeric value.", args[1]->pos);
+      FAIL_WITH("Expected a numeric value.", args.pos_of(0));
     }
 
     if (!as_numeric(inner->expr)) {
       if (has_else) {
-        return eval(args[3], env);
+        return eval(args[2], env);
       }
-      SUCCEED_WITH(u->pos, make_list());
+      SUCCEED_WITH(pos, make_list());
     } else {
-      return eval(args[2], env);
+      return eval(args[1], env);
     }
   }
 
@@ -823,59 +791,47 @@ namespace yl {
 
   }
 
-  inline result_type sorted_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, >= 1);
-    ASSERT_ARG_COUNT(u, <= 2);
+  inline result_type sorted_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, >= 1);
+    ASSERT_ARG_COUNT(args, <= 2);
 
-    LIST_OR_ERROR(args[1]);
-
-    unit_ptr ret = ::yl::make_shared<unit>(
-      u->pos, 
-      as_list(args[1]->expr)
-    );
+    LIST_OR_ERROR(args[0], args.pos_of(0));
 
-    auto& children = as_list(ret->expr);
+    auto const& ls = as_list(args[0]->expr);
 
-    if (children.empty()) {
-      return succeed(ret);
+    if (ls.empty()) {
+      SUCCEED_WITH(pos, make_list());
     }
 
-    bool has_custom_fn = args.size() > 2;
+    auto children = make_seq<unit_ptr>(ls.begin(), ls.end());
 
-    if (has_custom_fn && !is_function(args[2]->expr)) {
-      FAIL_WITH("Expected a comparison function.", args[2]->pos);
-    }
+    bool has_custom_fn = args.size() > 1;
 
-    auto const& sort_fn = 
-      has_custom_fn ? as_function(args[2]->expr).func : less_than_m;
+    if (has_custom_fn && !is_function(args[1]->expr)) {
+      FAIL_WITH("Expected a comparison function.", args.pos_of(1));
+    }
 
     auto err = detail::quick_sort(
       children.begin(), children.end(),
       [&](unit_ptr a, unit_ptr b) {
-        auto children = make_seq<unit_ptr>();
-
-        children.push_back(a);
-        children.push_back(a);
-        children.push_back(b);
+        unit_ptr const operands[] = {::std::move(a), ::std::move(b)};
+        auto const compared = argument_span{operands, 2};
 
-        return sort_fn(::yl::make_shared<unit>(
-          u->pos, 
-          ::std::move(children)
-        ), env);
+        return has_custom_fn
+          ? invoke(args[1], compared, pos, env)
+          : less_than_m(compared, pos, env);
       }
     );
 
     RETURN_IF_ERROR(err);
-    return succeed(ret);
+    SUCCEED_WITH(pos, make_list(children.begin(), children.end()));
   }
 
-  inline result_type stoi_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, == 1);
-    RAW_OR_ERROR(args[1]);
+  inline result_type stoi_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
+    RAW_OR_ERROR(args[0], args.pos_of(0));
 
-    auto const& str = as_string(args[1]->expr).str;
+    auto const& str = as_string(args[0]->expr).str;
 
     // non null char** required for strtoll
     char* eptr = reinterpret_cast<char*>(1);
@@ -887,70 +843,86 @@ namespace yl {
       if (eptr != sptr + str.size()) {
         FAIL_WITH(
           "Invalid number format. Expected a signed integer.", 
-          args[1]->pos
+          args.pos_of(0)
         );
       } else if (errno == ERANGE) {
         errno = 0;
         FAIL_WITH(
           "Given number does not fit into a 64bit signed integer.",
-          args[1]->pos
+          args.pos_of(0)
         );
       }
 
-      SUCCEED_WITH(args[1]->pos, n);
+      SUCCEED_WITH(args.pos_of(0), n);
     }
 
     FAIL_WITH(
       "Could not convert given number to a 64bit signed integer.", 
-      args[1]->pos
+      args.pos_of(0)
     );
   }
 
-  inline result_type str_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, == 1);
-    if (is_string(args[1]->expr)) {
-      return succeed(args[1]);
+  inline result_type str_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
+    if (is_string(args[0]->expr)) {
+      return succeed(args[0]);
     }
-    SUCCEED_WITH(u->pos, (string{.str = concat(args[1]->expr), .raw = true}));
+    SUCCEED_WITH(pos, (string{.str = concat(args[0]->expr), .raw = true}));
   }
 
-  inline result_type readlines_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, == 1);
-    RAW_OR_ERROR(args[1]);
+  inline result_type readlines_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
+    RAW_OR_ERROR(args[0], args.pos_of(0));
 
-    ::std::ifstream in{as_string(args[1]->expr).str.c_str()};
+    ::std::ifstream in{as_string(args[0]->expr).str.c_str()};
 
     if (!in.is_open()) {
-      FAIL_WITH("Unable to open given file.", args[1]->pos);
+      FAIL_WITH("Unable to open given file.", args.pos_of(0));
     }
 
-    list lines = make_list();
+    auto lines = make_seq<unit_ptr>();
+    // repeated lines are kept once
+    literal_table seen;
 
     auto line = make_string();
     while (::std::getline(in, line)) {
-      lines.push_back(
-        make_shared<unit>(args[1]->pos, string{::std::move(line), true}));  
+      lines.push_back(seen.share(
+        make_shared<unit>(args.pos_of(0), string{::std::move(line), true})));
     }
 
     if (lines.size() && as_string(lines.back()->expr).str.empty()) {
       lines.pop_back();
     }
 
-    SUCCEED_WITH(args[1]->pos, ::std::move(lines));
+    SUCCEED_WITH(args.pos_of(0), make_list(lines.begin(), lines.end()));
   }
 
-  inline result_type split_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, == 2);
-    RAW_OR_ERROR(args[1]);
-    RAW_OR_ERROR(args[2]);
+  inline result_type save_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, == 2);
+    RAW_OR_ERROR(args[0], args.pos_of(0));
+
+    RETURN_IF_ERROR(save_value(as_string(args[0]->expr).str.c_str(), args[1], args.pos_of(1)));
+    return succeed(args[1]);
+  }
+
+  inline result_type load_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
+    RAW_OR_ERROR(args[0], args.pos_of(0));
+
+    return load_value(as_string(args[0]->expr).str.c_str(), args.pos_of(0));
+  }
+
+  inline result_type split_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, == 2);
+    RAW_OR_ERROR(args[0], args.pos_of(0));
+    RAW_OR_ERROR(args[1], args.pos_of(1));
     
-    auto const& input = as_string(args[2]->expr).str;
-    auto const& delim = as_string(args[1]->expr).str;
+    auto const& input = as_string(args[1]->expr).str;
+    auto const& delim = as_string(args[0]->expr).str;
 
-    list ret = make_list();
+    auto ret = make_list().transient();
+    // repeated pieces are kept once
+    literal_table seen;
     ::std::size_t last_split = 0ul;
     ::std::size_t curr;
 
@@ -960,63 +932,59 @@ namespace yl {
         continue;
       }
 
-      ret.push_back(make_shared<unit>(
-        u->pos, 
+      ret.push_back(seen.share(make_shared<unit>(
+        pos, 
         string{
           .str = input.substr(last_split, curr - last_split),
           .raw = true
         }
-      ));
+      )));
       last_split = curr + delim.length();
     }
 
     if (last_split != input.length()) {
-      ret.push_back(make_shared<unit>(
-        u->pos, 
+      ret.push_back(seen.share(make_shared<unit>(
+        pos, 
         string{
           .str = input.substr(last_split, input.length() - last_split),
           .raw = true
         }
-      ));
+      )));
     }
 
-    SUCCEED_WITH(u->pos, ret);
+    SUCCEED_WITH(pos, ret.persistent());
   }
 
-  inline result_type err_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, == 1);
-    FAIL_WITH(as_string(str_m(u, env).value()->expr).str, args[1]->pos);
+  inline result_type err_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
+    FAIL_WITH(as_string(str_m(args, pos, env).value()->expr).str, args.pos_of(0));
   }
 
-  inline result_type mk_map_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    auto const& args = as_list(u->expr);
-    ASSERT_ARG_COUNT(u, == 1);
-    LIST_OR_ERROR(args[1]);
+  inline result_type mk_map_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
+    LIST_OR_ERROR(args[0], args.pos_of(0));
 
-    auto const& mappings = as_list(args[1]->expr);
+    auto const& mappings = as_list(args[0]->expr);
     if (mappings.size() % 2) {
       FAIL_WITH(
         "Map requires key value pairings, ie. an even number of elements.", 
-        args[1]->pos);
+        args.pos_of(0));
     }
 
-    hash_map ret;
+    auto ret = hash_map{}.transient();
 
     for (::std::size_t i = 0; i < mappings.size(); i += 2) {
-      // no transient..
-      ret = ret.insert({mappings[i], mappings[i + 1]});
+      ret.insert({mappings[i], mappings[i + 1]});
     }
 
-    SUCCEED_WITH(unit{u->pos, expression{ret}});
+    SUCCEED_WITH(pos, ret.persistent());
   }
 
-  inline result_type while_m(unit_ptr const& u, env_node_ptr& env) noexcept {
-    ASSERT_ARG_COUNT(u, == 2);
-    auto const& args = as_list(u->expr);
+  inline result_type while_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    ASSERT_ARG_COUNT(args, == 2);
 
     for (;;) {
-      auto const condition_either = eval(args[1], env);
+      auto const condition_either = eval(args[0], env);
       RETURN_IF_ERROR(condition_either);
       NUMERIC_OR_ERROR(condition_either.value()); 
       auto const condition = as_numeric(condition_either.value()->expr);
@@ -1025,29 +993,42 @@ namespace yl {
         break;
       }
 
-      auto const ret = eval(args[2], env);
+      auto const ret = eval(args[1], env);
       RETURN_IF_ERROR(ret);
     }    
 
-    SUCCEED_WITH(u->pos, make_list());
+    SUCCEED_WITH(pos, make_list());
   }
 
-  inline result_type keyword_m(unit_ptr const& u, env_node_ptr&) noexcept {
+  inline result_type do_m(argument_span const& args, position const& pos, env_node_ptr const& env) noexcept {
+    if (args.empty()) {
+      SUCCEED_WITH(pos, make_list());
+    }
+
+    for (::std::size_t i = 0; i < args.size() - 1; ++i) {
+      auto const result = eval(args[i], env);
+      RETURN_IF_ERROR(result);
+    }
+
+    return eval(args.back(), env);
+  }
+
+  inline result_type keyword_m(argument_span const&, position const& pos, env_node_ptr const&) noexcept {
     FAIL_WITH(
         "Keyword is not meant to be evaluated. "
-        "It is strictly used for parser/evaluator operations.", u->pos);
+        "It is strictly used for parser/evaluator operations.", pos);
   }
 
-  inline result_type is_atom_m(unit_ptr const& u, env_node_ptr&) noexcept {
-    ASSERT_ARG_COUNT(u, == 1);
-    auto const& arg = as_list(u->expr)[1]->expr;
-    SUCCEED_WITH(u->pos, expression{numeric{is_numeric(arg) || is_string(arg)}});
+  inline result_type is_atom_m(argument_span const& args, position const& pos, env_node_ptr const&) noexcept {
+    ASSERT_ARG_COUNT(args, == 1);
+    auto const& arg = args[0]->expr;
+    SUCCEED_WITH(pos, (numeric{is_numeric(arg) || is_string(arg)}));
   }
 
   #define TYPE_CHECK_M(type) \
-  inline result_type is_##type##_m(unit_ptr const& u, env_node_ptr&) noexcept { \
-    ASSERT_ARG_COUNT(u, == 1); \
-    SUCCEED_WITH(unit{u->pos, expression{numeric{is_##type(as_list(u->expr)[1]->expr)}}}); \
+  inline result_type is_##type##_m(argument_span const& args, position const& pos, env_node_ptr const&) noexcept { \
+    ASSERT_ARG_COUNT(args, == 1); \
+    SUCCEED_WITH(pos, numeric{is_##type(args[0]->expr)}); \
   }   
 
   TYPE_CHECK_M(numeric);
@@ -1056,28 +1037,50 @@ namespace yl {
   TYPE_CHECK_M(function);
 
   #define TYPE_CHECK_SPECIFIC(type) \
-  inline result_type is_##type##_m(unit_ptr const& u, env_node_ptr&) noexcept { \
-    ASSERT_ARG_COUNT(u, == 1); \
-    SUCCEED_WITH(unit{u->pos, expression{numeric{is_##type(as_list(u->expr)[1])}}}); \
+  inline result_type is_##type##_m(argument_span const& args, position const& pos, env_node_ptr const&) noexcept { \
+    ASSERT_ARG_COUNT(args, == 1); \
+    SUCCEED_WITH(pos, numeric{is_##type(args[0])}); \
   }   
 
   TYPE_CHECK_SPECIFIC(raw);
 
-  inline result_type time_ms_m(unit_ptr const& u, env_node_ptr&) noexcept {
+  inline result_type time_ms_m(argument_span const&, position const& pos, env_node_ptr const&) noexcept {
     auto const duration = 
       ::std::chrono::high_resolution_clock::now().time_since_epoch();
     auto const millis =
       ::std::chrono::duration_cast<::std::chrono::milliseconds>(duration)
         .count();
 
-    SUCCEED_WITH(u->pos, millis);
+    SUCCEED_WITH(pos, millis);
   }
 
-  inline result_type is_null_m(unit_ptr const& u, env_node_ptr&) noexcept {
-    return cast_list(u).collect(
-      [u](auto&&) { return make_shared<unit>(u->pos, false); },
-      [u](auto&& l) { return make_shared<unit>(u->pos, false);}
-    );
+  inline result_type mem_stats_m(argument_span const&, position const& pos, env_node_ptr const&) noexcept {
+    auto pools = make_list().transient();
+    for (auto* pool = slab_pool::first(); pool; pool = pool->next()) {
+      auto const stats = pool->stats();
+      auto entry = make_list().transient();
+      for (auto const n : {stats.object_size, stats.slabs, stats.used, stats.capacity}) {
+        entry.push_back(make_numeric(pos, static_cast<numeric>(n)));
+      }
+      pools.push_back(make_value(pos, entry.persistent()));
+    }
+#ifndef __EMSCRIPTEN__
+    auto const stats = mem_pool.stats();
+    auto chunks = make_list().transient();
+    for (auto const n : {region::chunk_size, stats.chunks, stats.pinned, stats.spare}) {
+      chunks.push_back(make_numeric(pos, static_cast<numeric>(n)));
+    }
+    pools.push_back(make_value(pos, chunks.persistent()));
+#endif
+    SUCCEED_WITH(pos, pools.persistent());
+  }
+
+  inline result_type mem_trim_m(argument_span const&, position const& pos, env_node_ptr const&) noexcept {
+    SUCCEED_WITH(pos, static_cast<numeric>(trim_slabs()));
+  }
+
+  inline result_type is_null_m(argument_span const&, position const& pos, env_node_ptr const&) noexcept {
+    SUCCEED_WITH(pos, false);
   }
 
 }
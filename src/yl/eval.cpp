@@ -1,23 +1,56 @@
 #include <iostream>
+#include <yl/arguments.hpp>
 #include <yl/eval.hpp>
+#include <yl/lexical.hpp>
+#include <yl/options.hpp>
 
 #include "builtins.hpp"
 #include "yl/types.hpp"
 
 namespace yl {
 
+  namespace {
+
+    // builtins keep answering the old convention, for callers that already
+    // have the whole call as a list
+    function make_builtin(
+      char const* description,
+      function::builtin_type const impl,
+      bool const macro = false
+    ) noexcept {
+      return function{
+        .description = make_string(description),
+        .func = [impl](unit_ptr const& u, env_node_ptr const& env) -> result_type {
+          auto const& ls = as_list(u->expr);
+          argument_window args{ls.size() - 1};
+          ::std::copy(ls.begin() + 1, ls.end(), args.data());
+          return impl(argument_span{args.data(), ls.size() - 1, &ls}, u->pos, env);
+        },
+        .macro = macro,
+        .compiled = {},
+        .builtin = impl
+      };
+    }
+
+  }
+
 #define BUILTIN_MACRO(name, desc, bind) \
   { \
-    make_string(name), \
-    make_shared<unit>(unit{{0, 0}, function{make_string(desc), bind, true}})} 
+    intern(make_string(name)), \
+    make_shared<unit>(unit{{0, 0}, make_builtin(desc, bind, true)})} 
 
 #define BUILTIN(name, desc, bind) \
   { \
-    make_string(name), \
-    make_shared<unit>(unit{{0, 0}, function{make_string(desc), bind}})} 
+    intern(make_string(name)), \
+    make_shared<unit>(unit{{0, 0}, make_builtin(desc, bind)})} 
    
-  env_node_ptr global_environment() noexcept {
-    auto static g_env = make_shared(environment{{
+  namespace {
+
+    using binding_table = PMR_PREF::unordered_map<symbol_id, unit_ptr>;
+
+    // what the global environment starts with
+    binding_table const& builtins() noexcept {
+      auto static const table = binding_table{{
       BUILTIN(
         ",",
         "Forces evaluation of an argument to macro function.\n"
@@ -127,6 +160,18 @@ namespace yl {
         "Example: 'readlines \"data.txt\"",
         readlines_m
       ),
+      BUILTIN(
+        "save",
+        "Writes a value to a file in a binary form, yields the value.\n"
+        "Example: 'save \"data.img\" (q (1 2 3))'",
+        save_m
+      ),
+      BUILTIN(
+        "load",
+        "Reads back a value written with save.\n"
+        "Example: 'load \"data.img\"'",
+        load_m
+      ),
       BUILTIN(
         "err",
         "Terminates interpretation of the current line.\n"
@@ -148,6 +193,13 @@ namespace yl {
         "Check whether the expression is an atom (not a collection).",
         is_atom_m
       ),
+      BUILTIN_MACRO(
+        "do",
+        "Evaluates its arguments in order and yields the value of the last one.\n"
+        "The last one is in tail position: '(fn f (n) (do (echo n) (f (+ n 1))))'\n"
+        "recurses forever without running out of stack.",
+        do_m
+      ),
       BUILTIN_MACRO(
         "__while",
         "Used exclusively for library optimization. Do not use in regular code.\n"
@@ -185,49 +237,138 @@ namespace yl {
         "Retrieves the time since epoch in milliseconds.",
         time_ms_m
       ),
+      BUILTIN(
+        "mem-stats",
+        "Lists the slabs runtime objects are allocated from, one\n"
+        "(object-size slabs used capacity) per object size, then\n"
+        "(chunk-size chunks pinned spare) for the region the rest comes from.",
+        mem_stats_m
+      ),
+      BUILTIN(
+        "mem-trim",
+        "Hands slabs without live objects back to the system, "
+        "yields how many bytes.",
+        mem_trim_m
+      ),
       BUILTIN(
         "null?",
         "Checks whether the value is ().",
         is_null_m
       ),
-    }, 1000
+      }, 1000
+#ifndef __EMSCRIPTEN__
+      , static_pool
+#endif
+      };
+
+      return table;
+    }
+
+  }
+
+  env_ptr const& global_frame() noexcept {
+    auto static const g_env = make_shared(environment{
+      .layout = {},
+      .slots = make_seq<unit_ptr>(),
+      .dynamic = {builtins().begin(), builtins().end(), 1000
 #ifndef __EMSCRIPTEN__
-    , &mem_pool
+      , static_pool
 #endif
-  });
+      }
+    });
 
+    return g_env;
+  }
+
+  unit_ptr const* find_builtin(symbol_id const id) noexcept {
+    auto const iter = builtins().find(id);
+    return iter == builtins().end() ? nullptr : &iter->second;
+  }
+
+  symbol_id builtin_name(unit const* u) noexcept {
+    for (auto const& [id, builtin] : builtins()) {
+      if (builtin.get() == u) {
+        return id;
+      }
+    }
+    return no_symbol;
+  }
+
+  env_node_ptr global_environment() noexcept {
     return make_shared<env_node>(env_node{
-      .curr = g_env,
+      .curr = global_frame(),
       .prev = {}
     });
   }
 
-  result_type resolve_symbol(unit_ptr const& pu, env_node_ptr node) noexcept {
+  result_type resolve_symbol(unit_ptr const& pu, env_node_ptr const& node) noexcept {
     if (!is_string(pu->expr)) {
       FAIL_WITH("Expected a symbol.", pu->pos);
     }
 
     //::std::cout << pu->expr << "\n";
 
-    auto starting_point = node;
-    auto s = as_string(pu->expr).str;
+    auto const* next = lookup(as_string(pu->expr), node);
+
+    if (!next) {
+      FAIL_WITH(
+        concat("Symbol ", as_string(pu->expr).str, " is undefined."), 
+        pu->pos
+      ); 
+    }
+
+    return succeed(*next);
+  }
+
+  either<error_info, ::std::size_t> force_marked(
+    unit_ptr* args, ::std::size_t const count, env_node_ptr const& node
+  ) noexcept {
+    auto static const comma = intern(make_string(","));
 
-    auto iter = node->curr->begin();
-    while ((iter = node->curr->find(s)) == node->curr->end()) {
-      if (!node->prev) {
-        FAIL_WITH(concat("Symbol ", s, " is undefined."), pu->pos); 
+    ::std::size_t kept = 0;
+    for (::std::size_t i = 0; i < count; ++i, ++kept) {
+      auto const& child = args[i]->expr;
+      if (is_string(child) && !as_string(child).raw
+          && symbol_of(as_string(child)) == comma && i + 1 < count) {
+        auto const v = eval(args[i + 1], node);
+        RETURN_IF_ERROR(v);
+        args[kept] = v.value();
+        ++i;
+      } else if (kept != i) {
+        args[kept] = ::std::move(args[i]);
       }
-      node = node->prev;
     }
 
-    auto next = iter->second;
+    return succeed(kept);
+  }
+
+  result_type invoke(
+    unit_ptr const& callee,
+    argument_span const& args,
+    position const& pos,
+    env_node_ptr const& env
+  ) noexcept {
+    auto const& fn = as_function(callee->expr);
+
+    if (fn.builtin) {
+      return fn.builtin(args, pos, env);
+    }
+
+    if (auto const* user = fn.func.template target<user_function>()) {
+      return (*user)(args, pos, env);
+    }
 
-    return succeed(make_shared(unit{pu->pos, next->expr}));
+    auto ls = make_list().transient();
+    ls.push_back(callee);
+    for (auto const& arg : args) {
+      ls.push_back(arg);
+    }
+    return fn.func(::yl::make_shared<unit>(pos, ls.persistent()), env);
   }
 
   result_type eval(
     unit_ptr const& pu, 
-    env_node_ptr node
+    env_node_ptr const& node
   ) noexcept {
     if (is_string(pu->expr)) {
       if (as_string(pu->expr).raw) {
@@ -238,80 +379,60 @@ namespace yl {
     }
 
     if (is_list(pu->expr)) {
-      auto ls = as_list(pu->expr);
+      auto const& ls = as_list(pu->expr);
 
       if (ls.empty()) {
         return succeed(pu);
       }
 
+      if (native_stack_exhausted()) {
+        FAIL_WITH("Maximum recursion depth exceeded.", pu->pos);
+      }
+
       auto const front = eval(ls[0], node);
       RETURN_IF_ERROR(front);
-      ls[0] = front.value();
+      auto const& callee = front.value();
 
-      auto const is_fn = is_function(ls.front()->expr);
+      auto const is_fn = is_function(callee->expr);
 
       if (ls.size() == 1 && !is_fn) {
-        return succeed(ls.front());
+        return succeed(callee);
       }
 
       if (!is_fn) {
         FAIL_WITH(
           concat(
             "Expected a builtin or user defined function, got ",
-            type_of(ls.front()->expr),
+            type_of(callee->expr),
             " with value ",
-            ls.front()->expr,
+            callee->expr,
             ", complete expression: ",
             pu->expr,
             "."
           ),
-          ls.front()->pos
+          reference_position(ls.front(), callee)
         );
       }
 
-      auto const& fn = as_function(ls.front()->expr);
-      if (!fn.macro) {
-        for (::std::size_t i = 1; i < ls.size(); ++i) {
-          auto& child = ls[i];
-          auto new_child = eval(child, node);
-          RETURN_IF_ERROR(new_child);
-          child = new_child.value();
+      auto count = ls.size() - 1;
+      argument_window args{count};
+      list const* call = nullptr;
+
+      if (!as_function(callee->expr).macro) {
+        call = &ls;
+        for (::std::size_t i = 0; i < count; ++i) {
+          auto const arg = eval(ls[i + 1], node);
+          RETURN_IF_ERROR(arg);
+          args[i] = arg.value();
         }
       } else {
-        ::std::size_t shrink = 0;
-        auto move_forward = [&shrink, &ls](auto&& i) {
-          if (shrink) {
-            ls[i - shrink] = ls[i];
-          }
-        };
-
-        for (::std::size_t i = 1; i < ls.size(); ++i) {
-          auto& child = ls[i]->expr;
-          if (!is_string(child)) {
-            move_forward(i);
-            continue;
-          }
-          auto& sym = as_string(child);
-          if (sym.raw) {
-            move_forward(i);
-            continue;
-          }
-
-          if (sym.str == ",") {
-            auto const v = eval(ls[i + 1], node);
-            RETURN_IF_ERROR(v);
-            ls[i - shrink] = v.value();
-            ++shrink;
-            i += 1;
-          } else {
-            move_forward(i);
-          }
-        }
-
-        ls.resize(ls.size() - shrink);
+        ::std::copy(ls.begin() + 1, ls.end(), args.data());
+        auto const kept = force_marked(args.data(), count, node);
+        RETURN_IF_ERROR(kept);
+        count = kept.value();
       }
 
-      return fn.func(::yl::make_shared<unit>(pu->pos, ls), node);
+      return invoke(callee, argument_span{args.data(), count, call}, pu->pos, node);
     }
 
     return succeed(pu);
@@ -0,0 +1,190 @@
+#include <algorithm>
+
+#include <yl/fold.hpp>
+#include <yl/lexical.hpp>
+
+#include "builtins.hpp"
+
+namespace yl {
+
+  namespace {
+
+    // builtins whose result only depends on their arguments
+    function::builtin_type const pure_builtins[] = {
+      add_m, sub_m, mul_m, div_m, mod_m,
+      and_m, or_m, xor_m, shl_m, shr_m,
+      equal_m, not_equal_m,
+      less_than_m, greater_than_m, less_or_equal_m, greater_or_equal_m,
+      len_m, head_m, tail_m,
+    };
+
+    bool is_pure(function::builtin_type const builtin) noexcept {
+      return ::std::find(
+        ::std::begin(pure_builtins), ::std::end(pure_builtins), builtin
+      ) != ::std::end(pure_builtins);
+    }
+
+    // a division that would trap stays where it crashes only if it runs
+    bool traps(
+      function::builtin_type const builtin, seq_representation<unit_ptr> const& values
+    ) noexcept {
+      if (builtin != &div_m && builtin != &mod_m) {
+        return false;
+      }
+      return ::std::any_of(values.begin() + 1, values.end(), [](auto const& u) {
+        return is_numeric(u->expr)
+          && (as_numeric(u->expr) == 0 || as_numeric(u->expr) == -1);
+      });
+    }
+
+    bool is_symbol(unit_ptr const& u) noexcept {
+      return is_string(u->expr) && !as_string(u->expr).raw;
+    }
+
+    // builtin the head of a call resolves to, unless a local binds the name
+    unit_ptr const* builtin_head(list const& ls) noexcept {
+      if (!is_symbol(ls.front())) {
+        return nullptr;
+      }
+
+      auto const& sym = as_string(ls.front()->expr);
+      if (is_local(sym)) {
+        return nullptr;
+      }
+
+      auto const* bound = global_frame()->find(symbol_of(sym));
+      if (!bound || !is_function((*bound)->expr)
+          || !as_function((*bound)->expr).builtin) {
+        return nullptr;
+      }
+      return bound;
+    }
+
+    void guard(folded& f, unit_ptr const& head, unit_ptr const& builtin) noexcept {
+      f.guards.emplace_back(head, builtin);
+    }
+
+    void take_guards(folded& into, folded const& from) noexcept {
+      into.guards.insert(into.guards.end(), from.guards.begin(), from.guards.end());
+    }
+
+    ::std::optional<folded> fold_if(
+      unit_ptr const& u, unit_ptr const& builtin
+    ) noexcept {
+      auto const& ls = as_list(u->expr);
+      if (ls.size() < 3 || ls.size() > 4) {
+        return ::std::nullopt;
+      }
+
+      auto condition = fold_condition(ls[1]);
+      if (!condition) {
+        return ::std::nullopt;
+      }
+
+      folded ret{nullptr, ::std::move(condition->guards)};
+      guard(ret, ls.front(), builtin);
+
+      if (as_numeric(condition->value->expr)) {
+        auto live = fold(ls[2]);
+        if (!live) {
+          return ::std::nullopt;
+        }
+        ret.value = live->value;
+        take_guards(ret, *live);
+      } else if (ls.size() == 4) {
+        auto live = fold(ls[3]);
+        if (!live) {
+          return ::std::nullopt;
+        }
+        ret.value = live->value;
+        take_guards(ret, *live);
+      } else {
+        ret.value = make_nil();
+      }
+
+      return ret;
+    }
+
+  }
+
+  ::std::optional<folded> fold(unit_ptr const& u) noexcept {
+    if (is_symbol(u)) {
+      return ::std::nullopt;
+    }
+
+    if (!is_list(u->expr) || as_list(u->expr).empty()) {
+      return folded{u, {}};
+    }
+
+    auto const& ls = as_list(u->expr);
+    auto const* bound = builtin_head(ls);
+    if (!bound) {
+      return ::std::nullopt;
+    }
+
+    auto const& fn = as_function((*bound)->expr);
+
+    if (fn.builtin == &quote_m) {
+      if (ls.size() != 2) {
+        return ::std::nullopt;
+      }
+      folded ret{ls[1], {}};
+      guard(ret, ls.front(), *bound);
+      return ret;
+    }
+
+    if (fn.builtin == &if_m) {
+      return fold_if(u, *bound);
+    }
+
+    if (fn.macro || !is_pure(fn.builtin)) {
+      return ::std::nullopt;
+    }
+
+    folded ret{nullptr, {}};
+    guard(ret, ls.front(), *bound);
+
+    auto values = make_seq<unit_ptr>();
+    values.reserve(ls.size() - 1);
+    for (::std::size_t i = 1; i < ls.size(); ++i) {
+      auto arg = fold(ls[i]);
+      if (!arg) {
+        return ::std::nullopt;
+      }
+      values.push_back(::std::move(arg->value));
+      take_guards(ret, *arg);
+    }
+
+    if (values.empty() || traps(fn.builtin, values)) {
+      return ::std::nullopt;
+    }
+
+    // errors such as a head of an empty list are left for when the call runs
+    auto env = global_environment();
+    auto const value = fn.builtin(
+      argument_span{values.data(), values.size(), &ls}, u->pos, env
+    );
+    if (!value) {
+      return ::std::nullopt;
+    }
+
+    ret.value = value.value();
+    return ret;
+  }
+
+  ::std::optional<folded> fold_condition(unit_ptr const& u) noexcept {
+    auto ret = fold(u);
+    if (!ret || !is_numeric(ret->value->expr)) {
+      return ::std::nullopt;
+    }
+    return ret;
+  }
+
+  bool still_holds(folded const& f, env_node_ptr const& node) noexcept {
+    return ::std::all_of(f.guards.begin(), f.guards.end(), [&node](auto const& g) {
+      auto const* value = lookup(as_string(g.first->expr), node);
+      return value && value->get() == g.second.get();
+    });
+  }
+
+}
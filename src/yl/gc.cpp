@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+#include <yl/gc.hpp>
+#include <yl/vm.hpp>
+
+#include "builtins.hpp"
+
+namespace yl {
+
+  namespace {
+
+    // set on the count of objects reached from outside the heap while
+    // collecting, the rest of the count stays intact
+    auto constexpr reached =
+      ::std::size_t{1} << (::std::numeric_limits<::std::size_t>::digits - 1);
+
+    // first collection happens at this many objects
+    auto constexpr initial_threshold = ::std::size_t{1} << 16;
+
+    ::std::size_t threshold = initial_threshold;
+
+    template<typename T>
+    counted<T>* block_of(counted_links* links) noexcept {
+      return static_cast<counted<T>*>(links);
+    }
+
+    template<typename T, typename F>
+    void for_each_block(F&& f) noexcept {
+      auto& head = heap_of<T>();
+      for (auto* links = head.next; links != &head; links = links->next) {
+        f(block_of<T>(links));
+      }
+    }
+
+    template<typename F>
+    void for_each_heap(F&& f) noexcept {
+      for_each_block<unit>(f);
+      for_each_block<environment>(f);
+      for_each_block<env_node>(f);
+    }
+
+    // a handle in shared storage is a single reference however many
+    // objects share it, the passes that count have to see it once
+    class counting : public tracer {
+     public:
+      bool first_visit(void const* storage) noexcept override {
+        return visited.insert(storage).second;
+      }
+
+     protected:
+      counting() noexcept {
+        visited.reserve(heap_size);
+      }
+      ~counting() = default;
+
+     private:
+      ::std::unordered_set<void const*> visited;
+    };
+
+    // counts of objects only referenced from inside the heap drop to zero
+    class subtract final : public counting {
+     public:
+      void operator()(unit_ptr const& u) noexcept override { drop(u); }
+      void operator()(env_ptr const& e) noexcept override { drop(e); }
+      void operator()(env_node_ptr const& n) noexcept override { drop(n); }
+
+     private:
+      template<typename T>
+      static void drop(ref<T> const& handle) noexcept {
+        auto* const block = handle.counted_block();
+        if (block && block->linked()) {
+          --block->refs;
+        }
+      }
+    };
+
+    class restore final : public counting {
+     public:
+      void operator()(unit_ptr const& u) noexcept override { add(u); }
+      void operator()(env_ptr const& e) noexcept override { add(e); }
+      void operator()(env_node_ptr const& n) noexcept override { add(n); }
+
+     private:
+      template<typename T>
+      static void add(ref<T> const& handle) noexcept {
+        auto* const block = handle.counted_block();
+        if (block && block->linked()) {
+          ++block->refs;
+        }
+      }
+    };
+
+    class mark final : public tracer {
+     public:
+      void operator()(unit_ptr const& u) noexcept override {
+        reach(u.counted_block(), units);
+      }
+      void operator()(env_ptr const& e) noexcept override {
+        reach(e.counted_block(), frames);
+      }
+      void operator()(env_node_ptr const& n) noexcept override {
+        reach(n.counted_block(), nodes);
+      }
+
+      // reaching an object twice is harmless
+      bool first_visit(void const*) noexcept override { return true; }
+
+      template<typename T>
+      void root(counted<T>* block) noexcept {
+        if (block->refs & ~reached) {
+          reach(block, work(static_cast<T*>(nullptr)));
+        }
+      }
+
+      void drain() noexcept {
+        while (!units.empty() || !frames.empty() || !nodes.empty()) {
+          visit(units);
+          visit(frames);
+          visit(nodes);
+        }
+      }
+
+     private:
+      template<typename T>
+      using pending = seq_representation<counted<T>*>;
+
+      pending<unit>& work(unit*) noexcept { return units; }
+      pending<environment>& work(environment*) noexcept { return frames; }
+      pending<env_node>& work(env_node*) noexcept { return nodes; }
+
+      template<typename T>
+      static void reach(counted<T>* block, pending<T>& work) noexcept {
+        if (block && block->linked() && !(block->refs & reached)) {
+          block->refs |= reached;
+          work.push_back(block);
+        }
+      }
+
+      template<typename T>
+      void visit(pending<T>& work) noexcept {
+        while (!work.empty()) {
+          auto* const block = work.back();
+          work.pop_back();
+          trace(block->value, *this);
+        }
+      }
+
+      pending<unit> units = make_seq<counted<unit>*>();
+      pending<environment> frames = make_seq<counted<environment>*>();
+      pending<env_node> nodes = make_seq<counted<env_node>*>();
+    };
+
+    // drops everything an object owns, references to the rest of the
+    // garbage go away with it
+    void clear(unit& u) noexcept {
+      u.expr = numeric{0};
+    }
+
+    void clear(environment& env) noexcept {
+      env.slots.clear();
+      env.dynamic.clear();
+    }
+
+    void clear(env_node& node) noexcept {
+      node.curr.reset();
+      node.prev.reset();
+    }
+
+    template<typename T>
+    void take_garbage(seq_representation<ref<T>>& garbage) noexcept {
+      for_each_block<T>([&garbage](counted<T>* block) {
+        if (block->refs & reached) {
+          block->refs &= ~reached;
+        } else {
+          garbage.push_back(ref<T>{block});
+        }
+      });
+    }
+
+    template<typename T>
+    void clear_all(seq_representation<ref<T>> const& garbage) noexcept {
+      for (auto const& handle : garbage) {
+        clear(*handle);
+      }
+    }
+
+  }
+
+  void trace(unit const& u, tracer& visit) noexcept {
+    if (is_list(u.expr)) {
+      trace(as_list(u.expr), visit);
+      return;
+    }
+
+    if (is_hash_map(u.expr)) {
+      for (auto const& entry : as_hash_map(u.expr)) {
+        if (visit.first_visit(&entry)) {
+          visit(entry.first);
+          visit(entry.second);
+        }
+      }
+      return;
+    }
+
+    if (!is_function(u.expr)) {
+      return;
+    }
+
+    auto const& fn = as_function(u.expr);
+
+    if (auto const* user = fn.func.template target<user_function>()) {
+      trace(user->sig.arglist, visit);
+      visit(user->body);
+      visit(user->closure);
+      visit(user->bound);
+    }
+
+    // copies of the function and its call wrapper share the closure
+    if (fn.compiled && visit.first_visit(fn.compiled.get())) {
+      vm::trace(*fn.compiled, visit);
+    }
+  }
+
+  void trace(environment const& env, tracer& visit) noexcept {
+    for (auto const& value : env.slots) {
+      visit(value);
+    }
+    for (auto const& [id, value] : env.dynamic) {
+      visit(value);
+    }
+  }
+
+  void trace(env_node const& node, tracer& visit) noexcept {
+    visit(node.curr);
+    visit(node.prev);
+  }
+
+  void trace(list const& ls, tracer& visit) noexcept {
+    for (auto const& element : ls) {
+      if (visit.first_visit(&element)) {
+        visit(element);
+      }
+    }
+  }
+
+  ::std::size_t collect_cycles() noexcept {
+    subtract sub;
+    for_each_heap([&sub](auto* block) { trace(block->value, sub); });
+
+    // whatever is still counted is referenced from the native stack,
+    // statics or opaque storage, everything those reach is alive
+    mark reach;
+    for_each_heap([&reach](auto* block) { reach.root(block); });
+    reach.drain();
+
+    restore add;
+    for_each_heap([&add](auto* block) { trace(block->value, add); });
+
+    auto units = make_seq<unit_ptr>();
+    auto frames = make_seq<env_ptr>();
+    auto nodes = make_seq<env_node_ptr>();
+    take_garbage(units);
+    take_garbage(frames);
+    take_garbage(nodes);
+
+    clear_all(units);
+    clear_all(frames);
+    clear_all(nodes);
+
+    return units.size() + frames.size() + nodes.size();
+  }
+
+  void collect_cycles_if_grown() noexcept {
+    if (heap_size < threshold) {
+      return;
+    }
+    collect_cycles();
+    trim_slabs();
+    threshold = ::std::max(initial_threshold, heap_size * 2);
+  }
+
+}
@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <vector>
+
 #include "yl/mem.hpp"
 #include <yl/history.hpp>
 
@@ -8,32 +13,90 @@
 
 namespace yl {
 
-#ifdef __EMSCRIPTEN__
-  seq_representation<string_representation> history::lines;
-#endif
+  namespace {
+
+    // consecutive lines that come out of the same text
+    struct block {
+      ::std::size_t first;
+      ::std::size_t count;
+      char const* text;
+      ::std::size_t size;
+      // where the line last looked up in the block starts, lookups of the
+      // lines after it go on from there
+      ::std::size_t last_line;
+      ::std::size_t last_offset;
+    };
+
+    struct lines {
+      ::std::deque<string_representation> typed;
+      ::std::vector<block> blocks;
+      ::std::size_t size = 0;
+    };
+
+    // never destroyed, errors may still be printed while the program exits
+    lines& all() noexcept {
+      static lines* const l = new lines;
+      return *l;
+    }
+
+    char const* line_end(block const& b, ::std::size_t const offset) noexcept {
+      auto const* const end = b.text + b.size;
+      auto const* const nl = static_cast<char const*>(
+        ::std::memchr(b.text + offset, '\n', b.size - offset));
+      return nl ? nl : end;
+    }
+
+  }
 
   void history::append(string_representation const& line) noexcept {
-#ifdef __EMSCRIPTEN__
-    lines.push_back(line);
-#else
+#ifndef __EMSCRIPTEN__
     ::add_history(line.c_str()); 
 #endif
+    auto const& kept = all().typed.emplace_back(line);
+    append_lines(kept.c_str(), kept.size());
+  }
+
+  ::std::size_t history::append_lines(
+      char const* text, ::std::size_t const size) noexcept {
+    auto& l = all();
+    auto const first = l.size;
+    auto const count = 1 + static_cast<::std::size_t>(
+      ::std::count(text, text + size, '\n'));
+    l.blocks.push_back(block{first, count, text, size, 0, 0});
+    l.size += count;
+    return first;
   }
 
   string_representation history::get(::std::size_t const idx) noexcept {
-#ifdef __EMSCRIPTEN__
-    return lines[idx];
-#else
-    return ::history_list()[idx]->line;
-#endif
+    auto& blocks = all().blocks;
+    auto iter = ::std::upper_bound(
+      blocks.begin(), blocks.end(), idx,
+      [](::std::size_t const i, block const& b) { return i < b.first; });
+
+    if (iter == blocks.begin()) {
+      return make_string();
+    }
+
+    auto& b = *--iter;
+    auto const target = idx - b.first;
+    auto const on = target >= b.last_line;
+    auto line = on ? b.last_line : 0;
+    auto offset = on ? b.last_offset : 0;
+
+    for (; line < target && offset <= b.size; ++line) {
+      offset = line_end(b, offset) - b.text + 1;
+    }
+    if (offset > b.size) {
+      return make_string();
+    }
+
+    b.last_line = line;
+    b.last_offset = offset;
+    return make_string(b.text + offset, line_end(b, offset));
   }
 
   ::std::size_t history::size() noexcept {
-#ifdef __EMSCRIPTEN__
-    return lines.size();
-#else
-    return ::history_length;
-#endif
+    return all().size;
   }
 
 }
@@ -0,0 +1,916 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+#include <yl/analyze.hpp>
+#include <yl/eval.hpp>
+#include <yl/image.hpp>
+#include <yl/lexical.hpp>
+#include <yl/options.hpp>
+#include <yl/util.hpp>
+#include <yl/vm.hpp>
+
+#include "builtins.hpp"
+
+#if defined(__unix__) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace yl {
+
+  // an image is a header followed by symbol names, layouts, frames without
+  // their bindings, environment nodes, units, the bindings of each frame
+  // and the units the image was made of. units come after everything they
+  // refer to, bindings come after the units so that closures stored in the
+  // frames they capture can be written
+  namespace {
+
+    char constexpr magic[8] = {'y', 'l', '-', 'i', 'm', 'a', 'g', 'e'};
+    ::std::uint32_t constexpr version = 2;
+
+    // the bindings of the global environment are in the image
+    ::std::uint32_t constexpr with_globals = 1;
+    // units are followed by their positions
+    ::std::uint32_t constexpr with_positions = 2;
+
+    enum class record : ::std::uint8_t {
+      small_integer,
+      nil,
+      integer,
+      raw_string,
+      symbol,
+      list,
+      map,
+      builtin,
+      function
+    };
+
+    using index = ::std::uint32_t;
+
+    // references that may be missing are stored one past their index
+    index constexpr none = 0;
+
+    position constexpr nowhere{0, 0};
+
+    template<typename T>
+    void put(string_representation& out, T const value) noexcept {
+      char bytes[sizeof(T)];
+      ::std::memcpy(bytes, &value, sizeof(T));
+      out.append(bytes, sizeof(T));
+    }
+
+    void put_bytes(string_representation& out, string_representation const& bytes) noexcept {
+      put<index>(out, static_cast<index>(bytes.size()));
+      out += bytes;
+    }
+
+    bool parts_of(function const& fn, function_parts& parts) noexcept {
+      if (auto const* user = fn.func.template target<user_function>()) {
+        parts = function_parts{
+          user->sig, user->body, user->closure, user->fk, user->bound
+        };
+        return true;
+      }
+      if (fn.compiled) {
+        parts = vm::parts_of(*fn.compiled);
+        return true;
+      }
+      return false;
+    }
+
+    template<typename F>
+    void for_each_child(unit const& u, F&& f) noexcept {
+      if (is_list(u.expr)) {
+        for (auto const& child : as_list(u.expr)) {
+          f(child.get());
+        }
+      } else if (is_hash_map(u.expr)) {
+        for (auto const& [key, value] : as_hash_map(u.expr)) {
+          f(key.get());
+          f(value.get());
+        }
+      } else if (is_function(u.expr)) {
+        function_parts parts;
+        if (!as_function(u.expr).builtin && parts_of(as_function(u.expr), parts)) {
+          for (auto const& arg : parts.sig.arglist) {
+            f(arg.get());
+          }
+          f(parts.body.get());
+        }
+      }
+    }
+
+    class image_writer {
+     public:
+      explicit image_writer(::std::uint32_t const flags) noexcept
+        : flags{flags}, globals{(flags & with_globals) != 0} {}
+
+      error_either<void> add_root(unit_ptr const& u) noexcept {
+        auto const i = unit_index(u.get());
+        RETURN_IF_ERROR(i);
+        roots.push_back(i.value());
+        return succeed();
+      }
+
+      // writes the bindings of every frame found so far, which may lead to
+      // more frames
+      error_either<void> add_frames() noexcept {
+        if (globals) {
+          frame_index(global_frame().get());
+        }
+
+        for (::std::size_t i = 0; i < frames.size(); ++i) {
+          auto const* env = frames[i];
+          if (env == global_frame().get() && !globals) {
+            put<::std::uint8_t>(bindings, 0);
+            continue;
+          }
+
+          // writing the values first keeps the bindings of a frame together
+          auto slots = make_seq<index>();
+          for (auto const& value : env->slots) {
+            if (!value) {
+              slots.push_back(none);
+              continue;
+            }
+            auto const u = unit_index(value.get());
+            RETURN_IF_ERROR(u);
+            slots.push_back(u.value() + 1);
+          }
+
+          auto dynamic = make_seq<::std::pair<index, index>>();
+          for (auto const& [id, value] : env->dynamic) {
+            // the reader starts out with these bound already
+            if (env == global_frame().get()) {
+              if (auto const* builtin = find_builtin(id); builtin && builtin->get() == value.get()) {
+                continue;
+              }
+            }
+            auto const u = unit_index(value.get());
+            RETURN_IF_ERROR(u);
+            dynamic.emplace_back(symbol_index(id), u.value());
+          }
+
+          put<::std::uint8_t>(bindings, 1);
+          put<index>(bindings, static_cast<index>(slots.size()));
+          for (auto const slot : slots) {
+            put<index>(bindings, slot);
+          }
+          put<index>(bindings, static_cast<index>(dynamic.size()));
+          for (auto const& [id, value] : dynamic) {
+            put<index>(bindings, id);
+            put<index>(bindings, value);
+          }
+        }
+
+        return succeed();
+      }
+
+      // the units are written out as they are, the rest is small
+      void finish(
+        ::std::ostream& out, ::std::uint64_t const key, ::std::size_t const first_line
+      ) const noexcept {
+        auto image = make_string();
+        image.append(magic, sizeof(magic));
+        put<::std::uint32_t>(image, version);
+        put<::std::uint32_t>(image, flags);
+        put<::std::uint64_t>(image, key);
+        put<::std::uint64_t>(image, first_line);
+
+        put<index>(image, static_cast<index>(symbol_indices.size()));
+        image += symbols;
+        put<index>(image, static_cast<index>(layout_indices.size()));
+        image += layouts;
+        put<index>(image, static_cast<index>(frames.size()));
+        image += shells;
+        put<index>(image, static_cast<index>(nodes.size()));
+        for (auto const& [frame, prev] : nodes) {
+          put<index>(image, frame);
+          put<index>(image, prev);
+        }
+        put<index>(image, static_cast<index>(unit_indices.size()));
+        out.write(image.data(), static_cast<::std::streamsize>(image.size()));
+        out.write(units.data(), static_cast<::std::streamsize>(units.size()));
+
+        image = bindings;
+        put<index>(image, static_cast<index>(roots.size()));
+        for (auto const root : roots) {
+          put<index>(image, root);
+        }
+        out.write(image.data(), static_cast<::std::streamsize>(image.size()));
+      }
+
+     private:
+      index symbol_index(symbol_id const id) noexcept {
+        auto const [iter, added] = symbol_indices.emplace(
+          id, static_cast<index>(symbol_indices.size())
+        );
+        if (added) {
+          put_bytes(symbols, symbol_name(id));
+        }
+        return iter->second;
+      }
+
+      index layout_index(frame_layout const* layout) noexcept {
+        auto const [iter, added] = layout_indices.emplace(
+          layout, static_cast<index>(layout_indices.size())
+        );
+        if (added) {
+          put<index>(layouts, static_cast<index>(layout->names.size()));
+          for (auto const id : layout->names) {
+            put<index>(layouts, symbol_index(id));
+          }
+        }
+        return iter->second;
+      }
+
+      index frame_index(environment const* env) noexcept {
+        auto const [iter, added] = frame_indices.emplace(
+          env, static_cast<index>(frames.size())
+        );
+        if (added) {
+          frames.push_back(env);
+          put<::std::uint8_t>(shells, env == global_frame().get());
+          put<index>(shells, env->layout ? layout_index(env->layout.get()) + 1 : none);
+          put<index>(shells, static_cast<index>(env->slots.size()));
+        }
+        return iter->second;
+      }
+
+      index node_index(env_node const* node) noexcept {
+        if (auto const iter = node_indices.find(node); iter != node_indices.end()) {
+          return iter->second;
+        }
+
+        auto const i = static_cast<index>(nodes.size());
+        node_indices.emplace(node, i);
+        nodes.emplace_back();
+
+        auto const frame = frame_index(node->curr.get());
+        auto const prev = node->prev ? node_index(node->prev.get()) + 1 : none;
+        nodes[i] = {frame, prev};
+        return i;
+      }
+
+      // units are written after their children, without recursing
+      either<error_info, index> unit_index(unit const* root) noexcept {
+        struct pending {
+          unit const* u;
+          bool expanded;
+        };
+
+        auto todo = make_seq<pending>();
+        todo.push_back({root, false});
+
+        while (!todo.empty()) {
+          auto const [u, expanded] = todo.back();
+          if (unit_indices.count(u)) {
+            todo.pop_back();
+            continue;
+          }
+
+          if (!expanded) {
+            todo.back().expanded = true;
+            for_each_child(*u, [this, &todo](unit const* child) {
+              if (!unit_indices.count(child)) {
+                todo.push_back({child, false});
+              }
+            });
+            continue;
+          }
+
+          todo.pop_back();
+          RETURN_IF_ERROR(write_unit(*u));
+          unit_indices.emplace(u, static_cast<index>(unit_indices.size()));
+        }
+
+        return succeed(unit_indices.at(root));
+      }
+
+      error_either<void> write_unit(unit const& u) noexcept {
+        auto const& expr = u.expr;
+
+        auto const head = [this, &u](record const r) {
+          put<::std::uint8_t>(units, static_cast<::std::uint8_t>(r));
+          if (flags & with_positions) {
+            put<::std::uint32_t>(units, u.pos.line);
+            put<::std::uint32_t>(units, u.pos.column);
+          }
+        };
+
+        if (immediates::get().contains(&u)) {
+          head(is_list(expr) ? record::nil : record::small_integer);
+          if (is_numeric(expr)) {
+            put<numeric>(units, as_numeric(expr));
+          }
+        } else if (is_numeric(expr)) {
+          head(record::integer);
+          put<numeric>(units, as_numeric(expr));
+        } else if (is_string(expr)) {
+          auto const& s = as_string(expr);
+          if (s.raw) {
+            head(record::raw_string);
+            put_bytes(units, s.str);
+          } else {
+            head(record::symbol);
+            put<index>(units, symbol_index(symbol_of(s)));
+          }
+        } else if (is_list(expr)) {
+          head(record::list);
+          put<index>(units, static_cast<index>(as_list(expr).size()));
+          for (auto const& child : as_list(expr)) {
+            put<index>(units, unit_indices.at(child.get()));
+          }
+        } else if (is_hash_map(expr)) {
+          head(record::map);
+          put<index>(units, static_cast<index>(as_hash_map(expr).size()));
+          for (auto const& [key, value] : as_hash_map(expr)) {
+            put<index>(units, unit_indices.at(key.get()));
+            put<index>(units, unit_indices.at(value.get()));
+          }
+        } else {
+          auto const& fn = as_function(expr);
+
+          if (fn.builtin) {
+            auto const id = builtin_name(&u);
+            if (id == no_symbol) {
+              FAIL_WITH("Can not write a builtin that is not bound at startup.", u.pos);
+            }
+            head(record::builtin);
+            put<index>(units, symbol_index(id));
+            return succeed();
+          }
+
+          function_parts parts;
+          if (!parts_of(fn, parts)) {
+            FAIL_WITH("Can not write a function that was not defined in yl.", u.pos);
+          }
+
+          head(record::function);
+          put_bytes(units, fn.description);
+          put<::std::uint8_t>(units, fn.macro);
+          put<::std::uint8_t>(units, static_cast<::std::uint8_t>(parts.fk));
+          put<::std::uint8_t>(units, parts.sig.variadic);
+          put<::std::uint8_t>(units, parts.sig.unused);
+          put<index>(units, static_cast<index>(parts.sig.arglist.size()));
+          for (auto const& arg : parts.sig.arglist) {
+            put<index>(units, unit_indices.at(arg.get()));
+          }
+          put<index>(units, static_cast<index>(parts.sig.offset));
+          put<index>(units, layout_index(parts.sig.layout.get()));
+          put<index>(units, unit_indices.at(parts.body.get()));
+          put<index>(units, parts.closure ? node_index(parts.closure.get()) + 1 : none);
+          put<index>(units, parts.bound ? frame_index(parts.bound.get()) + 1 : none);
+        }
+
+        return succeed();
+      }
+
+      ::std::uint32_t flags;
+      bool globals;
+
+      ::std::unordered_map<symbol_id, index> symbol_indices;
+      string_representation symbols = make_string();
+
+      ::std::unordered_map<frame_layout const*, index> layout_indices;
+      string_representation layouts = make_string();
+
+      ::std::unordered_map<environment const*, index> frame_indices;
+      seq_representation<environment const*> frames = make_seq<environment const*>();
+      string_representation shells = make_string();
+
+      ::std::unordered_map<env_node const*, index> node_indices;
+      seq_representation<::std::pair<index, index>> nodes =
+        make_seq<::std::pair<index, index>>();
+
+      ::std::unordered_map<unit const*, index> unit_indices;
+      string_representation units = make_string();
+
+      string_representation bindings = make_string();
+      seq_representation<index> roots = make_seq<index>();
+    };
+
+    // reads an image front to back, anything past its end or an index out
+    // of range marks it as broken
+    class image_source {
+     public:
+      image_source(char const* data, ::std::size_t const size) noexcept
+        : curr{data}, end{data + size} {}
+
+      template<typename T>
+      T get() noexcept {
+        T value{};
+        if (static_cast<::std::size_t>(end - curr) < sizeof(T)) {
+          broken = true;
+          return value;
+        }
+        ::std::memcpy(&value, curr, sizeof(T));
+        curr += sizeof(T);
+        return value;
+      }
+
+      string_representation bytes() noexcept {
+        auto const size = get<index>();
+        if (static_cast<::std::size_t>(end - curr) < size) {
+          broken = true;
+          return make_string();
+        }
+        curr += size;
+        return make_string(curr - size, curr);
+      }
+
+      // a number of records, each of which takes at least a byte of what is
+      // left, so that a broken count does not claim more than the file has
+      index count() noexcept {
+        auto const n = get<index>();
+        broken = broken || n > static_cast<::std::size_t>(end - curr);
+        return broken ? 0 : n;
+      }
+
+      index get_index(::std::size_t const count) noexcept {
+        auto const i = get<index>();
+        broken = broken || i >= count;
+        return broken ? 0 : i;
+      }
+
+      // one past the index, none if there is nothing
+      index get_optional(::std::size_t const count) noexcept {
+        auto const i = get<index>();
+        broken = broken || i > count;
+        return broken ? none : i;
+      }
+
+      // the item at the next index, an empty one once the image is broken
+      template<typename T>
+      T const& element_of(
+        seq_representation<T> const& items, ::std::size_t const count
+      ) noexcept {
+        static T const empty{};
+        auto const i = get_index(count);
+        return broken ? empty : items[i];
+      }
+
+      template<typename T>
+      T const& element_of(seq_representation<T> const& items) noexcept {
+        return element_of(items, items.size());
+      }
+
+      bool at_end() const noexcept {
+        return curr == end;
+      }
+
+      bool broken = false;
+
+     private:
+      char const* curr;
+      char const* end;
+    };
+
+    function rebuild(
+      function_parts const& parts,
+      string_representation const& description,
+      bool const macro
+    ) noexcept {
+      if (parts.fk != function_kind::syntax && parts.closure) {
+        resolve_lexical(parts.body, *parts.sig.layout, parts.closure);
+      }
+
+      auto fn = options.vm
+        ? vm::make_function(
+            parts.sig, parts.body, parts.closure, parts.fk, description, parts.bound
+          )
+        : function{
+            .description = description,
+            .func = create_function(
+              parts.sig, parts.body, analyze(parts.body, true),
+              parts.closure, parts.fk, parts.bound
+            )
+          };
+      fn.macro = macro;
+      return fn;
+    }
+
+    // what an image has to be for the reader to take it
+    struct image_kind {
+      bool globals;
+      ::std::uint64_t key;
+      ::std::size_t first_line;
+      // errors point here, as do units of images without positions
+      position at;
+    };
+
+#define IMAGE_BROKEN_IF(cond) \
+    if (in.broken || (cond)) { \
+      FAIL_WITH("Image is broken.", kind.at); \
+    }
+
+    error_either<void> read_image(
+      char const* data,
+      ::std::size_t const size,
+      image_kind const& kind,
+      seq_representation<unit_ptr>& roots
+    ) noexcept {
+      image_source in{data, size};
+
+      char header[sizeof(magic)] = {};
+      for (auto& c : header) {
+        c = in.get<char>();
+      }
+      IMAGE_BROKEN_IF(::std::memcmp(header, magic, sizeof(magic)) != 0);
+
+      auto const image_version = in.get<::std::uint32_t>();
+      auto const flags = in.get<::std::uint32_t>();
+      auto const image_key = in.get<::std::uint64_t>();
+      auto const image_line = in.get<::std::uint64_t>();
+      IMAGE_BROKEN_IF(false);
+
+      if (image_version != version) {
+        FAIL_WITH("Image was written by another version.", kind.at);
+      }
+      if (((flags & with_globals) != 0) != kind.globals) {
+        FAIL_WITH("Image holds another kind of value.", kind.at);
+      }
+      if (image_key != kind.key || image_line != kind.first_line) {
+        FAIL_WITH("Image was made from another text.", kind.at);
+      }
+      auto const positions = (flags & with_positions) != 0;
+
+      auto symbols = make_seq<symbol_id>();
+      symbols.resize(in.count());
+      IMAGE_BROKEN_IF(false);
+      for (auto& id : symbols) {
+        auto const name = in.bytes();
+        IMAGE_BROKEN_IF(name.empty());
+        id = intern(name);
+      }
+
+      auto layouts = make_seq<layout_ptr>();
+      layouts.resize(in.count());
+      IMAGE_BROKEN_IF(false);
+      for (auto& layout : layouts) {
+        auto names = make_seq<symbol_id>();
+        names.resize(in.count());
+        for (auto& id : names) {
+          id = in.element_of(symbols);
+        }
+        IMAGE_BROKEN_IF(false);
+        layout = make_layout(::std::move(names));
+      }
+
+      auto frames = make_seq<env_ptr>();
+      frames.resize(in.count());
+      IMAGE_BROKEN_IF(false);
+      for (auto& frame : frames) {
+        auto const global = in.get<::std::uint8_t>();
+        auto const layout = in.get_optional(layouts.size());
+        auto const slots = in.get<index>();
+        IMAGE_BROKEN_IF(
+          layout != none ? layouts[layout - 1]->names.size() != slots : slots
+        );
+
+        if (global) {
+          frame = global_frame();
+        } else {
+          auto values = make_seq<unit_ptr>();
+          values.resize(slots);
+          frame = make_shared(environment{
+            layout != none ? layouts[layout - 1] : layout_ptr{}, ::std::move(values)
+          });
+        }
+      }
+
+      auto nodes = make_seq<env_node_ptr>();
+      nodes.resize(in.count());
+      IMAGE_BROKEN_IF(false);
+      for (auto& node : nodes) {
+        node = make_shared<env_node>(env_node{});
+      }
+      for (auto& node : nodes) {
+        auto const& frame = in.element_of(frames);
+        auto const prev = in.get_optional(nodes.size());
+        IMAGE_BROKEN_IF(false);
+        node->curr = frame;
+        node->prev = prev != none ? nodes[prev - 1] : env_node_ptr{};
+      }
+
+      auto units = make_seq<unit_ptr>();
+      units.resize(in.count());
+      IMAGE_BROKEN_IF(false);
+      for (::std::size_t i = 0; i < units.size(); ++i) {
+        auto const r = static_cast<record>(in.get<::std::uint8_t>());
+        auto const pos = positions
+          ? position{in.get<::std::uint32_t>(), in.get<::std::uint32_t>()}
+          : kind.at;
+        IMAGE_BROKEN_IF(false);
+
+        switch (r) {
+        case record::small_integer: {
+          auto const n = in.get<numeric>();
+          IMAGE_BROKEN_IF(!immediates::get().has_integer(n));
+          units[i] = make_numeric(pos, n);
+          break;
+        }
+        case record::nil:
+          units[i] = make_nil();
+          break;
+        case record::integer:
+          units[i] = ::yl::make_shared<unit>(pos, in.get<numeric>());
+          break;
+        case record::raw_string:
+          units[i] = ::yl::make_shared<unit>(pos, string{in.bytes(), true});
+          break;
+        case record::symbol: {
+          auto const id = in.element_of(symbols);
+          IMAGE_BROKEN_IF(false);
+          string s{symbol_name(id)};
+          s.id = id;
+          s.site = symbol_site{};
+          units[i] = ::yl::make_shared<unit>(pos, ::std::move(s));
+          break;
+        }
+        case record::list: {
+          auto ls = make_list().transient();
+          for (auto n = in.count(); n; --n) {
+            auto const& child = in.element_of(units, i);
+            IMAGE_BROKEN_IF(false);
+            ls.push_back(child);
+          }
+          units[i] = ::yl::make_shared<unit>(pos, ls.persistent());
+          break;
+        }
+        case record::map: {
+          auto map = hash_map{}.transient();
+          for (auto n = in.count(); n; --n) {
+            auto const& key = in.element_of(units, i);
+            auto const& value = in.element_of(units, i);
+            IMAGE_BROKEN_IF(false);
+            map.insert({key, value});
+          }
+          units[i] = ::yl::make_shared<unit>(pos, map.persistent());
+          break;
+        }
+        case record::builtin: {
+          auto const* builtin = find_builtin(in.element_of(symbols));
+          IMAGE_BROKEN_IF(!builtin);
+          units[i] = *builtin;
+          break;
+        }
+        case record::function: {
+          auto const description = in.bytes();
+          auto const macro = in.get<::std::uint8_t>() != 0;
+          auto const fk = in.get<::std::uint8_t>();
+          auto const variadic = in.get<::std::uint8_t>() != 0;
+          auto const unused = in.get<::std::uint8_t>() != 0;
+
+          auto arglist = make_list().transient();
+          for (auto n = in.count(); n; --n) {
+            auto const& arg = in.element_of(units, i);
+            IMAGE_BROKEN_IF(false);
+            arglist.push_back(arg);
+          }
+
+          auto const offset = in.get<index>();
+          auto const& layout = in.element_of(layouts);
+          auto const& body = in.element_of(units, i);
+          auto const closure = in.get_optional(nodes.size());
+          auto const bound = in.get_optional(frames.size());
+          IMAGE_BROKEN_IF(
+            fk > static_cast<::std::uint8_t>(function_kind::syntax)
+            || offset + arglist.size() > layout->names.size() + variadic
+            || (bound != none && frames[bound - 1]->layout != layout)
+          );
+
+          auto const parts = function_parts{
+            signature{variadic, unused, arglist.persistent(), offset, layout},
+            body,
+            closure != none ? nodes[closure - 1] : env_node_ptr{},
+            static_cast<function_kind>(fk),
+            bound != none ? frames[bound - 1] : env_ptr{}
+          };
+          units[i] = ::yl::make_shared<unit>(pos, rebuild(parts, description, macro));
+          break;
+        }
+        default:
+          IMAGE_BROKEN_IF(true);
+        }
+
+        IMAGE_BROKEN_IF(false);
+      }
+
+      // frames are only bound once the whole image was read, the global
+      // one is live and others may be referred to by it
+      struct bindings {
+        bool bound = false;
+        seq_representation<unit_ptr> slots = make_seq<unit_ptr>();
+        seq_representation<::std::pair<symbol_id, unit_ptr>> dynamic =
+          make_seq<::std::pair<symbol_id, unit_ptr>>();
+      };
+
+      auto staged = make_seq<bindings>();
+      staged.resize(frames.size());
+      for (::std::size_t f = 0; f < frames.size(); ++f) {
+        auto const& frame = frames[f];
+        if (!in.get<::std::uint8_t>()) {
+          IMAGE_BROKEN_IF(frame != global_frame());
+          continue;
+        }
+        IMAGE_BROKEN_IF(frame == global_frame() && !kind.globals);
+        IMAGE_BROKEN_IF(in.get<index>() != frame->slots.size());
+
+        auto& frame_bindings = staged[f];
+        frame_bindings.bound = true;
+        frame_bindings.slots.reserve(frame->slots.size());
+        for (::std::size_t j = 0; j < frame->slots.size(); ++j) {
+          auto const value = in.get_optional(units.size());
+          IMAGE_BROKEN_IF(false);
+          frame_bindings.slots.push_back(value != none ? units[value - 1] : unit_ptr{});
+        }
+
+        for (auto n = in.count(); n; --n) {
+          auto const id = in.element_of(symbols);
+          auto const& value = in.element_of(units);
+          IMAGE_BROKEN_IF(false);
+          frame_bindings.dynamic.emplace_back(id, value);
+        }
+      }
+
+      roots.resize(in.count());
+      for (auto& root : roots) {
+        root = in.element_of(units);
+      }
+      IMAGE_BROKEN_IF(!in.at_end());
+
+      for (::std::size_t f = 0; f < frames.size(); ++f) {
+        auto& frame_bindings = staged[f];
+        if (!frame_bindings.bound) {
+          continue;
+        }
+        auto& frame = *frames[f];
+        frame.slots = ::std::move(frame_bindings.slots);
+        for (auto& [id, value] : frame_bindings.dynamic) {
+          if (frames[f] == global_frame()) {
+            frame.assign(id, ::std::move(value));
+          } else {
+            frame.dynamic[id] = ::std::move(value);
+          }
+        }
+      }
+      if (kind.globals) {
+        ++global_version;
+      }
+
+      return succeed();
+    }
+
+#undef IMAGE_BROKEN_IF
+
+    // the bytes of a file, mapped where that works
+    class file_bytes {
+     public:
+      explicit file_bytes(char const* path) noexcept {
+#if defined(__unix__) && !defined(__EMSCRIPTEN__)
+        auto const fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+          return;
+        }
+        auto fd_guard = make_scope_guard([fd] { ::close(fd); });
+
+        struct ::stat info;
+        if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size) {
+          auto* const mapped = ::mmap(
+            nullptr, static_cast<::std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0
+          );
+          if (mapped != MAP_FAILED) {
+            ::madvise(mapped, static_cast<::std::size_t>(info.st_size), MADV_SEQUENTIAL);
+            mapping = mapped;
+            data = static_cast<char const*>(mapped);
+            size = static_cast<::std::size_t>(info.st_size);
+            return;
+          }
+        }
+#endif
+
+        ::std::ifstream in{path, ::std::ios::binary};
+        if (!in.is_open()) {
+          return;
+        }
+        buffer.assign(
+          ::std::istreambuf_iterator<char>{in}, ::std::istreambuf_iterator<char>{}
+        );
+        data = buffer.data();
+        size = buffer.size();
+      }
+
+      file_bytes(file_bytes const&) = delete;
+      file_bytes& operator=(file_bytes const&) = delete;
+
+      ~file_bytes() {
+#if defined(__unix__) && !defined(__EMSCRIPTEN__)
+        if (mapping) {
+          ::munmap(mapping, size);
+        }
+#endif
+      }
+
+      char const* data = nullptr;
+      ::std::size_t size = 0;
+
+     private:
+      void* mapping = nullptr;
+      string_representation buffer = make_string();
+    };
+
+    // replaces path only once the whole image is written
+    error_either<void> write_file(
+      char const* path,
+      image_writer const& writer,
+      ::std::uint64_t const key,
+      ::std::size_t const first_line,
+      position const& at
+    ) noexcept {
+      auto const temporary = concat(path, ".tmp");
+      {
+        ::std::ofstream out{temporary, ::std::ios::binary | ::std::ios::trunc};
+        writer.finish(out, key, first_line);
+        if (!out) {
+          out.close();
+          ::std::remove(temporary.c_str());
+          FAIL_WITH(concat("Could not write ", temporary, "."), at);
+        }
+      }
+      if (::std::rename(temporary.c_str(), path) != 0) {
+        ::std::remove(temporary.c_str());
+        FAIL_WITH(concat("Could not replace ", path, "."), at);
+      }
+      return succeed();
+    }
+
+  }
+
+  // fnv-1a, stable across builds unlike std::hash
+  ::std::uint64_t image_key(char const* text, ::std::size_t const size) noexcept {
+    ::std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (::std::size_t i = 0; i < size; ++i) {
+      hash ^= static_cast<unsigned char>(text[i]);
+      hash *= 0x100000001b3ull;
+    }
+    return hash;
+  }
+
+  error_either<void> save_globals(
+    char const* path,
+    ::std::uint64_t const key,
+    ::std::size_t const first_line
+  ) noexcept {
+    image_writer writer{with_globals | with_positions};
+    RETURN_IF_ERROR(writer.add_frames());
+    return write_file(path, writer, key, first_line, nowhere);
+  }
+
+  error_either<void> load_globals(
+    char const* path,
+    ::std::uint64_t const key,
+    ::std::size_t const first_line
+  ) noexcept {
+    file_bytes const file{path};
+    if (!file.data) {
+      FAIL_WITH(concat("Could not open ", path, "."), nowhere);
+    }
+
+    auto roots = make_seq<unit_ptr>();
+    return read_image(
+      file.data, file.size, image_kind{true, key, first_line, nowhere}, roots
+    );
+  }
+
+  error_either<void> save_value(
+    char const* path, unit_ptr const& value, position const& pos
+  ) noexcept {
+    image_writer writer{0};
+    RETURN_IF_ERROR(writer.add_root(value));
+    RETURN_IF_ERROR(writer.add_frames());
+    return write_file(path, writer, 0, 0, pos);
+  }
+
+  result_type load_value(char const* path, position const& pos) noexcept {
+    file_bytes const file{path};
+    if (!file.data) {
+      FAIL_WITH(concat("Could not open ", path, "."), pos);
+    }
+
+    auto roots = make_seq<unit_ptr>();
+    RETURN_IF_ERROR(read_image(
+      file.data, file.size, image_kind{false, 0, 0, pos}, roots
+    ));
+    if (roots.size() != 1) {
+      FAIL_WITH("Image does not hold a single value.", pos);
+    }
+    return succeed(roots.front());
+  }
+
+}
@@ -0,0 +1,236 @@
+#include <algorithm>
+
+#include <yl/lexical.hpp>
+
+namespace yl {
+
+  namespace {
+
+    struct keywords {
+      symbol_id assign = intern(make_string("="));
+      symbol_id decomp = intern(make_string("decomp"));
+      symbol_id q      = intern(make_string("q"));
+      symbol_id quote  = intern(make_string("quote"));
+      symbol_id lambda = intern(make_string("\\"));
+      symbol_id macro  = intern(make_string("\\m"));
+      symbol_id syntax = intern(make_string("\\s"));
+    };
+
+    keywords const& kw() noexcept {
+      static keywords const k;
+      return k;
+    }
+
+    ::std::uint64_t next_layout_id() noexcept {
+      ::std::uint64_t static next_id = 0;
+      return ++next_id;
+    }
+
+    bool is_symbol(unit_ptr const& u) noexcept {
+      return is_string(u->expr) && !as_string(u->expr).raw;
+    }
+
+    symbol_id head_symbol(list const& ls) noexcept {
+      if (ls.empty() || !is_symbol(ls.front())) {
+        return no_symbol;
+      }
+      return symbol_of(as_string(ls.front()->expr));
+    }
+
+    // nested functions get their own frames, quoted code is data
+    bool opens_scope(symbol_id const head) noexcept {
+      auto const& k = kw();
+      return head == k.q || head == k.quote
+        || head == k.lambda || head == k.macro || head == k.syntax;
+    }
+
+    void add_name(seq_representation<symbol_id>& names, symbol_id const id) noexcept {
+      if (::std::find(names.begin(), names.end(), id) == names.end()) {
+        names.push_back(id);
+      }
+    }
+
+    void collect_targets(
+      unit_ptr const& target, seq_representation<symbol_id>& names
+    ) noexcept {
+      if (is_symbol(target)) {
+        add_name(names, symbol_of(as_string(target->expr)));
+      } else if (is_list(target->expr)) {
+        for (auto const& child : as_list(target->expr)) {
+          collect_targets(child, names);
+        }
+      }
+    }
+
+    void collect_locals(
+      unit_ptr const& u, seq_representation<symbol_id>& names
+    ) noexcept {
+      if (!is_list(u->expr)) {
+        return;
+      }
+
+      auto const& ls = as_list(u->expr);
+      auto const head = head_symbol(ls);
+
+      if (opens_scope(head)) {
+        return;
+      }
+
+      ::std::size_t first = 0;
+      if ((head == kw().assign || head == kw().decomp) && ls.size() > 1) {
+        collect_targets(ls[1], names);
+        first = 2;
+      }
+
+      for (::std::size_t i = first; i < ls.size(); ++i) {
+        collect_locals(ls[i], names);
+      }
+    }
+
+    void annotate(
+      unit_ptr const& u,
+      ::std::uint64_t const owner,
+      seq_representation<frame_layout const*> const& scope,
+      bool const global
+    ) noexcept {
+      if (is_list(u->expr)) {
+        auto const& ls = as_list(u->expr);
+        if (opens_scope(head_symbol(ls))) {
+          return;
+        }
+        for (auto const& child : ls) {
+          annotate(child, owner, scope, global);
+        }
+        return;
+      }
+
+      if (!is_symbol(u)) {
+        return;
+      }
+
+      auto& sym = as_string(u->expr);
+      auto const id = symbol_of(sym);
+      if (!sym.site) {
+        sym.site = symbol_site{};
+      }
+
+      for (::std::size_t depth = 0; depth < scope.size(); ++depth) {
+        auto const& names = scope[depth]->names;
+        for (::std::size_t slot = 0; slot < names.size(); ++slot) {
+          if (names[slot] == id) {
+            sym.site->addr = lexical_address{
+              owner, 
+              static_cast<::std::uint32_t>(depth), 
+              static_cast<::std::uint32_t>(slot)
+            };
+            return;
+          }
+        }
+      }
+
+      if (global) {
+        sym.site->addr = lexical_address{
+          owner,
+          static_cast<::std::uint32_t>(scope.size()),
+          lexical_address::global_slot
+        };
+      }
+    }
+
+  }
+
+  layout_ptr make_layout(list const& arglist, unit_ptr const& body) noexcept {
+    auto names = make_seq<symbol_id>();
+    for (auto const& arg : arglist) {
+      auto const& sym = as_string(arg->expr);
+      if (sym.str[0] != '&') {
+        names.push_back(symbol_of(sym));
+      }
+    }
+
+    collect_locals(body, names);
+
+    return make_layout(::std::move(names));
+  }
+
+  layout_ptr make_layout(seq_representation<symbol_id> names) noexcept {
+    return make_shared(frame_layout{next_layout_id(), ::std::move(names)});
+  }
+
+  void resolve_lexical(
+    unit_ptr const& body,
+    frame_layout const& layout,
+    env_node_ptr const& closure
+  ) noexcept {
+    auto scope = make_seq<frame_layout const*>();
+    scope.push_back(&layout);
+
+    // frames without a layout hold names that are only known at runtime
+    auto node = closure.get();
+    for (; node && node->curr->layout; node = node->prev.get()) {
+      scope.push_back(node->curr->layout.get());
+    }
+
+    // names bound nowhere in scope can go straight to the global
+    // environment when that is where the chain continues
+    annotate(body, layout.id, scope, node && node->curr == global_frame());
+  }
+
+  error_either<env_ptr> bind_arguments(
+    signature const& sig,
+    unit_ptr const* arguments,
+    ::std::size_t const count,
+    position const& pos,
+    env_ptr const& bound
+  ) noexcept {
+    auto const& arglist = sig.arglist;
+
+    if (!sig.variadic && arglist.size() < count) {
+      FAIL_WITH(
+        concat(
+          "Excess arguments, expected ",
+          arglist.size(),
+          ", got ",
+          count,
+          "."
+        ),
+        pos
+      );
+    }
+
+    // TODO: does it work without this?
+    if (sig.variadic && arglist.size() > count + 1 + !sig.unused) {
+      FAIL_WITH(
+        "Not enough values to assign to non-variadic parameters.",
+        pos
+      );
+    }
+
+    auto frame = bound ? make_shared(environment{*bound}) : make_frame(sig.layout);
+    auto& slots = frame->slots;
+
+    for (::std::size_t i = 0; i != (arglist.size() ? count : 0); ++i) {
+      auto const& sym = as_string(arglist[i]->expr);
+      if (sym.str[0] == '&') {
+        if (sig.unused) {
+          break;
+        }
+
+        slots[sig.offset + i] = ::yl::make_shared<unit>(
+          arguments[i]->pos,
+          make_list(arguments + i, arguments + count)
+        );
+        break;
+      }
+
+      slots[sig.offset + i] = arguments[i]; // fix eval with respect to macros
+    }
+
+    if (count < arglist.size() - sig.variadic && !sig.unused) {
+      slots[sig.offset + arglist.size() - 1 - sig.variadic] = make_nil();
+    }
+
+    return succeed(frame);
+  }
+
+}
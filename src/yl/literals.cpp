@@ -0,0 +1,70 @@
+#include <algorithm>
+
+#include <yl/literals.hpp>
+#include <yl/type_operations.hpp>
+
+namespace yl {
+
+  unit_ptr literal_table::share(unit_ptr u) noexcept {
+    auto const& expr = u->expr;
+
+    auto const shareable = is_numeric(expr)
+      || (is_string(expr) && as_string(expr).raw)
+      || (is_list(expr) && ::std::all_of(
+            as_list(expr).begin(), as_list(expr).end(),
+            [this](auto const& child) { return is_literal(child); }));
+
+    if (!shareable) {
+      return u;
+    }
+
+    if (auto const iter = units.find(u); iter != units.end()) {
+      return *iter;
+    }
+
+    prune();
+    units.insert(u);
+    return u;
+  }
+
+  bool literal_table::is_literal(unit_ptr const& u) const noexcept {
+    auto const& expr = u->expr;
+
+    if (is_numeric(expr)) {
+      return true;
+    }
+    if (is_string(expr)) {
+      return as_string(expr).raw;
+    }
+    if (!is_list(expr)) {
+      return false;
+    }
+
+    // equality tells raw strings from symbols, so a list equal to one in
+    // the table is made of literals as well
+    return units.find(u) != units.end();
+  }
+
+  void literal_table::prune() noexcept {
+    if (units.size() < limit) {
+      return;
+    }
+
+    for (auto iter = units.begin(); iter != units.end(); ) {
+      if (iter->use_count() == 1) {
+        iter = units.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+
+    limit = ::std::max(limit, units.size() * 2);
+  }
+
+  // never destroyed, like the immediates
+  literal_table& parsed_literals() noexcept {
+    static literal_table* const table = new literal_table;
+    return *table;
+  }
+
+}
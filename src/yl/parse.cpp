@@ -1,32 +1,62 @@
-#include <cerrno>
+#include <algorithm>
+#include <charconv>
 #include <iostream>
 #include <stdexcept>
 #include <cctype>
+#include <limits>
 
 #include <yl/types.hpp>
 #include <yl/either.hpp>
 #include <yl/util.hpp>
 #include <yl/parse.hpp>
 #include <yl/mem.hpp>
+#include <yl/lex.hpp>
+#include <yl/literals.hpp>
+#include <yl/options.hpp>
 #include <yl/type_operations.hpp>
 
 namespace yl {
 
   using pos = ::std::size_t;
-  using prf = pos&;
 
-  bool is_eof(char const* line, pos const curr) noexcept {
-    return !line[curr];
+  // where the parser is in the text it was given. a form read from a file
+  // may span lines, columns are counted from the start of the line they
+  // are on
+  struct cursor {
+    char const* text;
+    // the form ends here or at a null, whichever comes first
+    pos end;
+    pos curr;
+    ::std::size_t line;
+    pos line_start;
+  };
+
+  position at(cursor const& c, pos const p) noexcept {
+    return position{
+      static_cast<::std::uint32_t>(c.line),
+      static_cast<::std::uint32_t>(p - c.line_start)
+    };
   }
 
-  // skips whitespace
-  void skip(char const* line, prf curr) noexcept {
-    if (is_eof(line, curr)) {
-      return;
-    }
+  bool is_eof(cursor const& c) noexcept {
+    return c.curr >= c.end || !c.text[c.curr];
+  }
 
-    while (::std::isblank(line[curr])) {
-      ++curr;
+  // skips whitespace, along with the line breaks and comments of forms
+  // read from files
+  void skip(cursor& c) noexcept {
+    while (!is_eof(c)) {
+      auto const ch = c.text[c.curr];
+      if (ch == ' ' || ch == '\t' || ch == '\r') {
+        ++c.curr;
+      } else if (ch == '\n') {
+        ++c.line;
+        c.line_start = ++c.curr;
+      } else if (ch == ';') {
+        c.curr = scan_to<'\n'>(c.text + c.curr) - c.text;
+      } else {
+        return;
+      }
     }
   }
 
@@ -38,36 +68,35 @@ namespace yl {
     return c == ')' ? c : 0;
   }
 
-  char paren(char const c) noexcept {
-    return left_paren(c) ?: right_paren(c);
-  }
-
   ::std::size_t skip_str(char const* line, ::std::size_t pos) noexcept {
     if (!line[pos] || line[pos] != '\"') {
       return pos;
     }
-    while (line[++pos] && line[pos] != '\"') {
-      if (line[pos] == '\\') {
-        ++pos;
+    while (true) {
+      pos = scan_to<'\"', '\\'>(line + pos + 1) - line;
+      if (line[pos] != '\\') {
+        return pos;
       }
+      if (!line[pos + 1]) {
+        return pos + 1;
+      }
+      ++pos;
     }
-    return pos;
   }
 
   int paren_balance(char const* line) noexcept {
     pos p = 0;
     int balance = 0;
 
-    while (line[p]) {
+    while (line[p = scan_to<'\"', '(', ')'>(line + p) - line]) {
       if (line[p] == '\"') {
         p = skip_str(line, p);
         if (!line[p]) {
           break;
         }
-      }
-      if (left_paren(line[p])) {
+      } else if (left_paren(line[p])) {
         --balance;
-      } else if (right_paren(line[p])) {
+      } else {
         ++balance;
       }
 
@@ -77,148 +106,187 @@ namespace yl {
     return balance;
   }
 
-  result_type parse_raw_string(
-      char const* line, ::std::size_t const line_num, prf curr) noexcept {
-    ::std::unordered_map<char, char> const static escaped{
-      {'n', '\n'}, 
-      {'t', '\t'}, 
-      {'r', '\t'}, 
-      {'v', '\v'},
-    };
+  // \r has always read as a tab
+  char escaped(char const c) noexcept {
+    switch (c) {
+      case 'n': return '\n';
+      case 't': return '\t';
+      case 'r': return '\t';
+      case 'v': return '\v';
+      default:  return c;
+    }
+  }
 
+  // strings end with their line
+  bool is_end_of_string(cursor const& c) noexcept {
+    return is_eof(c) || c.text[c.curr] == '\n';
+  }
 
-    pos start = curr;
+  result_type parse_raw_string(cursor& c) noexcept {
+    pos start = c.curr;
     string s;
     s.raw = true;
 
-    while (line[curr] != '\"') {
-      if (is_eof(line, curr)) {
-        return fail(error_info{"Unexpected EOF.", {line_num, curr}});
-      }
+    // everything up to the next quote or escape goes in at once
+    while (true) {
+      auto const* const stop = scan_to<'\"', '\\', '\n'>(c.text + c.curr);
+      s.str.append(c.text + c.curr, stop);
+      c.curr = stop - c.text;
 
-      if (line[curr] == '\\') {
-        ++curr;
-        if (is_eof(line, curr)) {
-          return fail(error_info{"Unexpected EOF.", {line_num, curr}});
-        }
-        if (auto const iter = escaped.find(line[curr]); iter != escaped.end()) {
-          s.str += iter->second;
-        } else {
-          s.str += line[curr];
-        }
-      } else {
-        s.str += line[curr];
+      if (is_end_of_string(c)) {
+        return fail(error_info{"Unexpected EOF.", at(c, c.curr)});
+      }
+      if (c.text[c.curr] == '\"') {
+        break;
       }
 
-      ++curr;
+      ++c.curr;
+      if (is_end_of_string(c)) {
+        return fail(error_info{"Unexpected EOF.", at(c, c.curr)});
+      }
+      s.str += escaped(c.text[c.curr]);
+      ++c.curr;
     }
 
-    ++curr;
-    SUCCEED_WITH((position{line_num, start}), s);
+    ++c.curr;
+    SUCCEED_WITH(at(c, start), s);
   }
 
   bool special_char(char const c) noexcept {
     return c == ',';
   }
 
-  result_type parse_terminal(
-      char const* line, ::std::size_t const line_num, prf curr) noexcept {
-    if (line[curr] == '\"') {
-      return parse_raw_string(line, line_num, ++curr);
+  result_type parse_terminal(cursor& c) noexcept {
+    if (c.text[c.curr] == '\"') {
+      ++c.curr;
+      return parse_raw_string(c);
     }
 
-    pos const start = curr;
+    pos const start = c.curr;
     
-    if (!special_char(line[curr])) {
-      while (!is_eof(line, curr) && !::std::isblank(line[curr]) 
-              && !paren(line[curr])) {
-        ++curr;
-      }
+    if (!special_char(c.text[c.curr])) {
+      c.curr = ::std::min(
+        c.end,
+        static_cast<pos>(
+          scan_to<' ', '\t', '\r', '\n', ';', '(', ')'>(c.text + c.curr) - c.text));
     } else {
-      ++curr;
+      ++c.curr;
     }
 
-    string s{{line + start, line + curr}};
+    auto const* const begin = c.text + start;
+    auto const* const end = c.text + c.curr;
 
-    // non null char** required for strtoll
-    char* eptr = reinterpret_cast<char*>(1);
-    char const* sptr = s.str.c_str();
+    // converted straight from the input, with a leading plus accepted like
+    // strtoll did
+    auto const* const digits = begin + (*begin == '+' && end - begin > 1
+      && ::std::isdigit(static_cast<unsigned char>(begin[1])));
+    numeric n = 0;
+    auto const [eptr, ec] = ::std::from_chars(digits, end, n);
+    auto const taken = ec == ::std::errc::invalid_argument ? 0 : eptr - begin;
 
-    auto const n = ::std::strtoll(sptr, &eptr, 10);
-
-    if (eptr > sptr && (eptr - sptr > 1 || ::std::isdigit(*(sptr)))) {
-      if (eptr != sptr + s.str.size()) {
+    if (taken > 1 || (taken && ::std::isdigit(static_cast<unsigned char>(*begin)))) {
+      if (eptr != end) {
         FAIL_WITH(
           "Invalid number format. Expected a signed integer.", 
-          (position{line_num, start + (eptr - sptr)})
+          at(c, start + taken)
         );
-      } else if (errno == ERANGE) {
-        errno = 0;
+      } else if (ec == ::std::errc::result_out_of_range) {
         FAIL_WITH(
           "Given number does not fit into a 64bit signed integer.",
-          (position{line_num, start + (eptr - sptr)})
+          at(c, start + taken)
         );
       }
 
-      SUCCEED_WITH((position{line_num, start}), n);
+      // literals keep their own position for errors that point at them
+      return succeed(::yl::make_shared<unit>(at(c, start), n));
     }
 
-    SUCCEED_WITH((position{line_num, start}), s);
+    string s{make_string(begin, end)};
+
+    s.id = intern(s.str);
+    s.site = symbol_site{};
+    SUCCEED_WITH(at(c, start), ::std::move(s));
+  }
+
+  // only the nodes of a list are shared, the unit around them keeps the
+  // position it was read at so that errors about the list do not point at
+  // an equal one elsewhere. numbers and strings are a unit and nothing
+  // more, sharing them would only move their position
+  unit_ptr share_literal(unit_ptr u) noexcept {
+    if (!options.share_literals || !is_list(u->expr) || as_list(u->expr).empty()) {
+      return u;
+    }
+
+    auto const shared = parsed_literals().share(u);
+    if (shared.get() == u.get()) {
+      return u;
+    }
+    return ::yl::make_shared<unit>(u->pos, shared->expr);
   }
 
   result_type parse_expression(
-      char const* line, ::std::size_t const line_num, prf curr,
-      char const close_parenthesis = '\0') noexcept {
-    skip(line, curr);
-    if (is_eof(line, curr)) {
-      FAIL_WITH("Expression expected.", (position{line_num, curr}));
+      cursor& c, char const close_parenthesis = '\0') noexcept {
+    skip(c);
+    if (is_eof(c)) {
+      FAIL_WITH("Expression expected.", at(c, c.curr));
     }
 
-    auto ls = make_list();
-    auto expr = unit{{line_num, curr}};
+    auto ls = make_list().transient();
+    auto expr = unit{at(c, c.curr)};
 
-    while (!is_eof(line, curr) && !right_paren(line[curr])) {
-      if (!left_paren(line[curr])) {
-        auto res = parse_terminal(line, line_num, curr);
+    while (!is_eof(c) && !right_paren(c.text[c.curr])) {
+      if (!left_paren(c.text[c.curr])) {
+        auto res = parse_terminal(c);
         RETURN_IF_ERROR(res);
-        ls.emplace_back(res.value());
+        ls.push_back(share_literal(res.value()));
       } else {
-        ++curr;
-        auto res = parse_expression(line, line_num, curr, ')');
+        ++c.curr;
+        auto res = parse_expression(c, ')');
         RETURN_IF_ERROR(res);
 
-        ls.emplace_back(res.value());
+        ls.push_back(share_literal(res.value()));
       }
 
-      skip(line, curr);
+      skip(c);
     }
 
     if (close_parenthesis) {
-      if (!is_eof(line, curr) && right_paren(line[curr])) {
-        if (line[curr] != close_parenthesis) {
+      if (!is_eof(c) && right_paren(c.text[c.curr])) {
+        if (c.text[c.curr] != close_parenthesis) {
           FAIL_WITH(
             concat("Differing parentesis, expected ", close_parenthesis, " got ",
-                   line[curr], "."),
-            (position{line_num, curr}));
+                   c.text[c.curr], "."),
+            at(c, c.curr));
         }
-        ++curr;
+        ++c.curr;
       } else {
-        FAIL_WITH("Expected closing parenthesis.", (position{line_num, curr}));
+        FAIL_WITH("Expected closing parenthesis.", at(c, c.curr));
       }
     }
 
-    expr.expr = ::std::move(ls); 
+    expr.expr = ls.persistent();
     return succeed(make_shared(::std::move(expr)));
   }
 
-  result_type parse(char const* line, ::std::size_t const line_num) noexcept {
-    pos p = 0;
-    auto ret = parse_expression(line, line_num, p, false);
+  result_type parse_form(cursor c) noexcept {
+    auto ret = parse_expression(c);
     RETURN_IF_ERROR(ret);
-    if (right_paren(line[p])) {
-      FAIL_WITH("Unmatched parenthesis.", (position{line_num, p}));
+    if (!is_eof(c) && right_paren(c.text[c.curr])) {
+      FAIL_WITH("Unmatched parenthesis.", at(c, c.curr));
     }
     return ret;
   }
 
+  result_type parse(char const* line, ::std::size_t const line_num) noexcept {
+    return parse_form(cursor{
+      line, ::std::numeric_limits<pos>::max(), 0, line_num, 0
+    });
+  }
+
+  result_type parse(
+      char const* text, ::std::size_t const begin, ::std::size_t const end,
+      ::std::size_t const line_num) noexcept {
+    return parse_form(cursor{text, end, begin, line_num, begin});
+  }
+
 }
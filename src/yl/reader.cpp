@@ -0,0 +1,126 @@
+#include <cctype>
+#include <cstring>
+
+#include <yl/lex.hpp>
+#include <yl/parse.hpp>
+#include <yl/reader.hpp>
+
+namespace yl {
+
+  bool form_reader::append(char* line) noexcept {
+    auto* p = line;
+    while (::std::isblank(static_cast<unsigned char>(*p))) {
+      ++p;
+    }
+    if (!*p || *p == ';') {
+      return false;
+    }
+
+    // the comment is cut off and parentheses outside of strings counted in
+    // the same pass
+    while (*(p = const_cast<char*>(scan_to<';', '\"', '(', ')'>(p)))) {
+      if (*p == ';') {
+        *p = 0;
+        break;
+      }
+      if (*p == '\"') {
+        p = line + skip_str(line, p - line);
+        if (!*p) {
+          break;
+        }
+      } else if (*p == '(') {
+        --balance;
+      } else {
+        ++balance;
+      }
+      ++p;
+    }
+
+    if (lines++) {
+      buffer += ' ';
+    }
+    buffer.append(line, p);
+    return true;
+  }
+
+  namespace {
+
+    bool is_blank(char const c) noexcept {
+      return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    // past the closing quote of the string p is at, or at the end of its
+    // line if it is not closed on it
+    char const* past_string(char const* p) noexcept {
+      while (true) {
+        p = scan_to<'\"', '\\', '\n'>(p + 1);
+        if (*p != '\\') {
+          return *p == '\"' ? p + 1 : p;
+        }
+        if (!p[1] || p[1] == '\n') {
+          return p + 1;
+        }
+        ++p;
+      }
+    }
+
+  }
+
+  bool source_reader::next(form_span& form) noexcept {
+    auto const* const stop = text + size;
+    int balance = 0;
+    bool started = false;
+
+    while (curr < size) {
+      auto const* p = text + curr;
+      while (is_blank(*p)) {
+        ++p;
+      }
+      auto const blank = !*p || *p == '\n' || *p == ';';
+
+      // parentheses outside of strings and comments, up to the end of line
+      while (true) {
+        p = scan_to<'\n', ';', '\"', '(', ')'>(p);
+        if (*p == '(') {
+          --balance;
+          ++p;
+        } else if (*p == ')') {
+          ++balance;
+          ++p;
+        } else if (*p == '\"') {
+          p = past_string(p);
+        } else if (*p == ';' || (!*p && p < stop)) {
+          // the rest of a line after a comment or a null is not looked at
+          auto const* const nl = static_cast<char const*>(
+            ::std::memchr(p, '\n', stop - p));
+          p = nl ? nl : stop;
+        } else {
+          break;
+        }
+      }
+
+      auto const line_begin = curr;
+      auto const line_end = static_cast<::std::size_t>(p - text);
+      curr = line_end + 1;
+
+      if (!blank) {
+        if (!started) {
+          started = true;
+          form.begin = line_begin;
+          form.first_line = line;
+        }
+        form.end = line_end;
+        form.last_line = line;
+      }
+      ++line;
+
+      if (started && balance >= 0) {
+        return true;
+      }
+    }
+
+    // a form still open at the end of the file is handed on as it is
+    return started;
+  }
+
+}
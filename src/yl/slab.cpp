@@ -0,0 +1,127 @@
+#include <new>
+
+#ifndef __EMSCRIPTEN__
+#include <sys/mman.h>
+#endif
+
+#include <yl/options.hpp>
+#include <yl/slab.hpp>
+#include <yl/util.hpp>
+
+namespace yl {
+
+  namespace detail {
+
+#ifndef __EMSCRIPTEN__
+    // maps twice the size and cuts off whatever is not aligned, so that
+    // unmapping an empty slab gives its pages back right away
+    void* map_slab(::std::size_t const size, bool const huge) noexcept {
+      auto* const mapped = static_cast<::std::byte*>(::mmap(
+        nullptr, size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+      ));
+      if (mapped == MAP_FAILED) {
+        terminate_with("Out of memory.");
+      }
+
+      auto const address = reinterpret_cast<::std::uintptr_t>(mapped);
+      auto* const aligned = reinterpret_cast<::std::byte*>(
+        (address + size - 1) & ~(size - 1)
+      );
+
+      if (aligned != mapped) {
+        ::munmap(mapped, aligned - mapped);
+      }
+      ::munmap(aligned + size, mapped + size - aligned);
+
+#ifdef MADV_HUGEPAGE
+      if (huge) {
+        ::madvise(aligned, size, MADV_HUGEPAGE);
+      }
+#endif
+
+      return aligned;
+    }
+
+    void unmap_slab(void* slab, ::std::size_t const size) noexcept {
+      ::munmap(slab, size);
+    }
+#else
+    void* map_slab(::std::size_t const size, bool const) noexcept {
+      return ::operator new(size, ::std::align_val_t{size});
+    }
+
+    void unmap_slab(void* slab, ::std::size_t const size) noexcept {
+      ::operator delete(slab, ::std::align_val_t{size});
+    }
+#endif
+
+  }
+
+  slab_pool::slab* slab_pool::grow() noexcept {
+    if (!bytes) {
+      bytes = options.huge_pages ? huge_slab_size : slab_size;
+      next_pool = pools;
+      pools = this;
+    }
+
+    auto* const s = static_cast<slab*>(detail::map_slab(bytes, options.huge_pages));
+    auto* const start = reinterpret_cast<::std::byte*>(s);
+    *s = slab{
+      nullptr,
+      nullptr,
+      nullptr,
+      start + header,
+      start + header + (bytes - header) / object_size * object_size,
+      0,
+      false
+    };
+
+    ++slabs;
+    link(s);
+    return s;
+  }
+
+  ::std::size_t slab_pool::trim() noexcept {
+    ::std::size_t released = 0;
+
+    for (auto* s = partial; s;) {
+      auto* const next = s->next;
+      if (!s->live) {
+        unlink(s);
+        detail::unmap_slab(s, bytes);
+        --slabs;
+        released += bytes;
+      }
+      s = next;
+    }
+
+    return released;
+  }
+
+  slab_stats slab_pool::stats() const noexcept {
+    if (!bytes) {
+      return slab_stats{object_size};
+    }
+
+    auto const per_slab = (bytes - header) / object_size;
+    slab_stats stats{object_size, slabs, 0, slabs * per_slab};
+
+    // full slabs are not listed, everything they have room for is used
+    ::std::size_t vacant = 0;
+    for (auto* s = partial; s; s = s->next) {
+      vacant += per_slab - s->live;
+    }
+
+    stats.used = stats.capacity - vacant;
+    return stats;
+  }
+
+  ::std::size_t trim_slabs() noexcept {
+    ::std::size_t released = 0;
+    for (auto* pool = slab_pool::first(); pool; pool = pool->next()) {
+      released += pool->trim();
+    }
+    return released;
+  }
+
+}
@@ -0,0 +1,48 @@
+#include <deque>
+#include <unordered_map>
+
+#include <yl/symbol.hpp>
+
+namespace yl {
+
+  namespace {
+
+    struct symbol_table {
+      PMR_PREF::unordered_map<string_representation, symbol_id> ids{
+#ifndef __EMSCRIPTEN__
+        static_pool
+#endif
+      };
+      // deque keeps references to names stable while the table grows
+      PMR_PREF::deque<string_representation> names{
+#ifndef __EMSCRIPTEN__
+        static_pool
+#endif
+      };
+    };
+
+    symbol_table& table() noexcept {
+      static symbol_table t;
+      return t;
+    }
+
+  }
+
+  symbol_id intern(string_representation const& name) noexcept {
+    auto& t = table();
+
+    if (auto const iter = t.ids.find(name); iter != t.ids.end()) {
+      return iter->second;
+    }
+
+    auto const id = static_cast<symbol_id>(t.names.size());
+    t.names.push_back(name);
+    t.ids.emplace(name, id);
+    return id;
+  }
+
+  string_representation const& symbol_name(symbol_id const id) noexcept {
+    return table().names[id];
+  }
+
+}
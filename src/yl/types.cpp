@@ -6,7 +6,7 @@ namespace yl {
   ::std::ostream& operator<<(::std::ostream& out, expression const& e) noexcept {
     ::std::visit(overloaded {
       [&out](numeric any) { out << any; },
-      [&out](string any) { 
+      [&out](string const& any) { 
         if (any.raw) {
           out << "\"";
         }
@@ -15,8 +15,8 @@ namespace yl {
           out << "\"";
         }
       },
-      [&out](function fn) { out << fn.description; },
-      [&out](list ls) {
+      [&out](out_of_line<function> const& fn) { out << fn->description; },
+      [&out](list const& ls) {
         out << "(";
         for (::std::size_t i = 0; i < ls.size(); ++i) {
           if (i)
@@ -25,7 +25,7 @@ namespace yl {
         }
         out << ")";
       },
-      [&out](hash_map m) {
+      [&out](hash_map const& m) {
         out << "{";
         for (auto const& [k, v] : m) {
           out << "\n"
@@ -46,13 +46,144 @@ namespace yl {
   ::std::string type_of(expression const& e) noexcept {
     return ::std::visit(overloaded {
       [](numeric) { return "numeric"; },
-      [](string) { return "string"; },
-      [](function) { return "function"; },
-      [](list) { return "list"; },
-      [](hash_map) { return "map"; }
+      [](string const&) { return "string"; },
+      [](out_of_line<function> const&) { return "function"; },
+      [](list const&) { return "list"; },
+      [](hash_map const&) { return "map"; }
     }, e);
   }
 
+  namespace {
+
+    // finalizer of splitmix64, every bit of the input affects every bit
+    // of the result
+    ::std::size_t mix(::std::uint64_t x) noexcept {
+      x ^= x >> 30;
+      x *= 0xbf58476d1ce4e5b9;
+      x ^= x >> 27;
+      x *= 0x94d049bb133111eb;
+      x ^= x >> 31;
+      return static_cast<::std::size_t>(x);
+    }
+
+    // order matters, (1 2) and (2 1) hash differently
+    ::std::size_t combine(::std::size_t const seed, ::std::size_t const h) noexcept {
+      return mix(seed ^ (h + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2)));
+    }
+
+    ::std::size_t structural_hash(expression const& e) noexcept {
+      auto const seed = mix(e.index() + 1);
+      auto const hasher = unit_hasher{};
+
+      return ::std::visit(overloaded {
+        [seed](numeric n) {
+          return combine(seed, mix(static_cast<::std::uint64_t>(n)));
+        },
+        [seed](string const& s) {
+          return combine(
+            combine(seed, s.raw), ::std::hash<string_representation>{}(s.str)
+          );
+        },
+        // hashed by identity instead, see unit_hasher
+        [seed](out_of_line<function> const&) {
+          return seed;
+        },
+        [seed, &hasher](list const& ls) {
+          auto ret = combine(seed, ls.size());
+          for (auto const& child : ls) {
+            ret = combine(ret, hasher(child));
+          }
+          return ret;
+        },
+        // maps with the same pairs may iterate in different orders
+        [seed, &hasher](hash_map const& hm) {
+          ::std::size_t sum = 0;
+          for (auto const& [k, v] : hm) {
+            sum += combine(hasher(k), hasher(v));
+          }
+          return combine(combine(seed, hm.size()), sum);
+        }
+      }, e);
+    }
+
+    ::std::size_t cached_hash(unit_ptr const& u) noexcept {
+      return u.counted_block()->hash;
+    }
+
+    bool needs_hash(unit_ptr const& u) noexcept {
+      return (is_list(u->expr) || is_hash_map(u->expr)) && !cached_hash(u);
+    }
+
+    template<typename F>
+    void for_each_child(unit_ptr const& u, F&& f) noexcept {
+      if (is_list(u->expr)) {
+        for (auto const& child : as_list(u->expr)) {
+          f(child);
+        }
+      } else if (is_hash_map(u->expr)) {
+        for (auto const& [key, value] : as_hash_map(u->expr)) {
+          f(key);
+          f(value);
+        }
+      }
+    }
+
+    void cache_hash(unit_ptr const& u) noexcept {
+      auto const h = structural_hash(u->expr);
+      u.counted_block()->hash = h ? h : 1;
+    }
+
+    // lists and maps below root are hashed before the ones holding them,
+    // without recursing, so that deeply nested ones do not overflow the stack
+    void cache_hashes(unit_ptr const& root) noexcept {
+      auto nested = false;
+      for_each_child(root, [&nested](unit_ptr const& child) {
+        nested = nested || needs_hash(child);
+      });
+      if (!nested) {
+        cache_hash(root);
+        return;
+      }
+
+      struct pending {
+        unit_ptr const* u;
+        bool expanded;
+      };
+
+      auto todo = make_seq<pending>();
+      todo.push_back({&root, false});
+
+      while (!todo.empty()) {
+        auto const [u, expanded] = todo.back();
+        if (cached_hash(*u)) {
+          todo.pop_back();
+          continue;
+        }
+
+        if (!expanded) {
+          todo.back().expanded = true;
+          for_each_child(*u, [&todo](unit_ptr const& child) {
+            if (needs_hash(child)) {
+              todo.push_back({&child, false});
+            }
+          });
+          continue;
+        }
+
+        todo.pop_back();
+        cache_hash(*u);
+      }
+    }
+
+    // hashes of both are known and tell them apart without descending
+    bool known_different(unit_ptr const& a, unit_ptr const& b) noexcept {
+      auto const ha = cached_hash(a);
+      auto const hb = cached_hash(b);
+      return ha && hb && ha != hb;
+    }
+
+  }
+
   bool operator==(unit_ptr const& a, unit_ptr const& b) noexcept {
     if (a.get() == b.get()) {
       return true;
@@ -66,6 +197,10 @@ namespace yl {
       return as_numeric(a->expr) == as_numeric(b->expr);
     }
 
+    if (known_different(a, b)) {
+      return false;
+    }
+
     if (is_string(a->expr)) {
       auto const& sa = as_string(a->expr);
       auto const& sb = as_string(b->expr);
@@ -89,38 +224,19 @@ namespace yl {
   }
 
   ::std::size_t unit_hasher::operator()(unit_ptr const& u) const noexcept {
-    return ::std::visit(overloaded {
-      [](numeric n) { 
-        return ::std::hash<numeric>{}(n); 
-      },
-      [](string s) { 
-        // TODO: combine these two properly
-        return 
-          ::std::hash<string_representation>{}(s.str) 
-            ^ ::std::hash<bool>{}(s.raw); 
-      },
-      [](function) {
-        return ::std::size_t{0}; 
-      },
-      [](list ls) {
-        // TODO:
-        ::std::size_t ret{};
-        auto hasher = unit_hasher{};
-        for (auto&& child : ls) {
-          ret ^= hasher(child);
-        }
-        return ret;
-      },
-      [](hash_map hm) { 
-        // TODO:
-        ::std::size_t ret = 0;
-        auto hasher = unit_hasher{};
-        for (auto const& [k, v] : hm) {
-          ret ^= (hasher(k) << 7) ^ (hasher(v));
-        }
-        return ret;
-      }
-    }, u->expr);
+    if (is_numeric(u->expr)) {
+      return structural_hash(u->expr);
+    }
+
+    // a function is only equal to itself
+    if (is_function(u->expr)) {
+      return mix(reinterpret_cast<::std::uintptr_t>(u.get()));
+    }
+
+    if (!cached_hash(u)) {
+      cache_hashes(u);
+    }
+    return cached_hash(u);
   }
 
 }
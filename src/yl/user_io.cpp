@@ -1,33 +1,49 @@
 #include <sstream>
 #include <yl/user_io.hpp>
 #include <yl/parse.hpp>
+#include <yl/analyze.hpp>
 #include <yl/eval.hpp>
+#include <yl/gc.hpp>
 #include <yl/util.hpp>
 #include <yl/types.hpp>
 #include <yl/mem.hpp>
+#include <yl/options.hpp>
+#include <yl/vm.hpp>
 #include <yl/history.hpp>
+#include <yl/image.hpp>
+#include <yl/reader.hpp>
 
 #include <cctype>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <iterator>
 #include <iostream>
 #include <limits>
 #include <string>
 #include <memory>
+#include <optional>
 #include <utility>
 #include <variant>
 
+#if defined(__unix__) && !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace yl {
 
   void print_error(
     ::std::size_t const prompt_offset,
     bool const continuated,
     error_info const& err,
-    ::std::ostream& std_err
+    ::std::ostream& std_err,
+    ::std::size_t const first
   ) noexcept {
-    auto const past =
-      history::size() - err.pos.line - 1;
+    // lines of the failed form itself are not in the past
+    auto const past = err.pos.line < first ? first - err.pos.line : 0;
     
     if (past || continuated) {
       if (past) {
@@ -44,6 +60,44 @@ namespace yl {
     std_err << err.error_message;
   }
 
+  namespace {
+
+    // first is the line the form starts on, the history has all of it
+    void evaluate(
+      result_type const& parse_expr,
+      ::std::size_t const prompt_offset,
+      bool const continuated,
+      ::std::size_t const first,
+      ::std::ostream& std_out,
+      ::std::ostream& std_err
+    ) noexcept {
+      if (!parse_expr) {
+        print_error(
+          prompt_offset, continuated, parse_expr.error(), std_err, first);
+        return;
+      }
+
+      char start;
+      stack_start = reinterpret_cast<::std::uintptr_t>(&start);
+
+      // top level forms go through the analyzer to be folded like bodies
+      auto const eval_expr = options.vm
+        ? vm::run(parse_expr.value(), global_environment())
+        : options.fold
+          ? analyze(parse_expr.value())(global_environment())
+          : eval(parse_expr.value());
+
+      if (!eval_expr) {
+        print_error(
+          prompt_offset, continuated, eval_expr.error(), std_err, first);
+        return;
+      }
+
+      std_out << eval_expr.value()->expr;
+    }
+
+  }
+
   void handle_input(
     char const* user_input,
     ::std::size_t const prompt_offset,
@@ -51,45 +105,17 @@ namespace yl {
     ::std::ostream& std_out,
     ::std::ostream& std_err
   ) noexcept {
-    auto const parse_expr = parse(user_input, history::size());
-    history::append(user_input);
-
-    if (!parse_expr) {
-      print_error(prompt_offset, continuated, parse_expr.error(), std_err);
-      return;
+    // nothing from the previous form is being evaluated anymore
+    if (options.collect) {
+      collect_cycles_if_grown();
     }
 
-    auto const eval_expr = eval(parse_expr.value());
-
-    if (!eval_expr) {
-      print_error(prompt_offset, continuated, eval_expr.error(), std_err);
-      return;
-    }
-
-    std_out << eval_expr.value()->expr; 
-  }
-
-  namespace detail {
-
-    // true if empty
-    bool preproccess(char* line) {
-      bool empty = true;
-      ::std::size_t idx = 0;
-      while (line[idx]) {
-        if (line[idx] == ';') {
-          line[idx] = 0;
-          return empty;
-        } else {
-          idx = skip_str(line, idx);
-        }
-
-        empty = empty && ::std::isblank(line[idx]);
-        ++idx;
-      }
-
-      return empty;
-    }
+    auto const parse_expr = parse(user_input, history::size());
+    history::append(user_input);
 
+    evaluate(
+      parse_expr, prompt_offset, continuated, history::size() - 1,
+      std_out, std_err);
   }
 
   // true if eof
@@ -99,48 +125,32 @@ namespace yl {
     ::std::ostream& out,
     ::std::ostream& err
   ) noexcept {
-    ::std::size_t constexpr static buf_size = 1 << 13;
-    char buf[buf_size];
-    buf[0] = 0;
-
-    auto* input = line_supplier();
-
-    if (!input) {
-      return true;
-    }
+    form_reader reader;
 
-    if (::yl::detail::preproccess(input)) {
-      ::free(input);
-      return false;
-    }
-
-    auto balance = ::yl::paren_balance(input);
-    auto continuated = balance < 0;
-
-    ::std::strcat(buf, input);
-    ::free(input);
-
-    while (balance < 0) {
-      input = line_supplier();
+    while (!reader.complete()) {
+      auto* input = line_supplier();
       if (!input) {
         break;
       }
 
-      if (::yl::detail::preproccess(input)) {
-        ::free(input);
-        continue; 
-      }
-      balance += ::yl::paren_balance(input);
-      ::std::strcat(buf, " ");
-      ::std::strcat(buf, input);
+      auto const added = reader.append(input);
       ::free(input);
+
+      // a blank or comment line outside of a form is skipped
+      if (!added && !reader.continuated()) {
+        return false;
+      }
+    }
+
+    if (!reader.complete() && !reader.continuated()) {
+      return true;
     }
 
     if (!p_sz) {
-      out << buf << "\n";
+      out << reader.form() << "\n";
     }
 
-    ::yl::handle_input(buf, p_sz, continuated, out, err);
+    ::yl::handle_input(reader.form(), p_sz, reader.continuated(), out, err);
     out << "\n";
 
     if (!p_sz) {
@@ -150,48 +160,144 @@ namespace yl {
     return false;
   }
 
+  ::std::optional<source_file> open_source(char const* path) noexcept {
+#if defined(__unix__) && !defined(__EMSCRIPTEN__)
+    auto const fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      return ::std::nullopt;
+    }
+    auto fd_guard = make_scope_guard([fd] { ::close(fd); });
+
+    struct ::stat info;
+    if (::fstat(fd, &info) != 0) {
+      return ::std::nullopt;
+    }
+
+    // the text has to be followed by a null, which the rest of the last
+    // page of a mapping is filled with
+    auto const size = static_cast<::std::size_t>(info.st_size);
+    auto const page = static_cast<::std::size_t>(::sysconf(_SC_PAGESIZE));
+    if (S_ISREG(info.st_mode) && size % page) {
+      auto* const mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        ::madvise(mapped, size, MADV_SEQUENTIAL);
+        return source_file{static_cast<char const*>(mapped), size};
+      }
+    }
+#endif
+
+    ::std::ifstream in{path, ::std::ios::binary};
+    if (!in.is_open()) {
+      return ::std::nullopt;
+    }
+
+    // never freed, like a mapping
+    auto* const text = new string_representation{
+      ::std::istreambuf_iterator<char>{in}, ::std::istreambuf_iterator<char>{}
+    };
+    return source_file{text->c_str(), text->size()};
+  }
+
   void handle_file(
-    ::std::ifstream&& file,
+    source_file const& file,
     ::std::ostream& out,
     ::std::ostream& err
   ) noexcept {
-    while (!::yl::handle_line(
-      [&file] { 
-        ::std::size_t constexpr static buf_size = 1 << 13;
-        char* buf = reinterpret_cast<char*>(::malloc(buf_size));
-
-        if (file.getline(buf, buf_size)) {
-          return buf;
-        }
-        
-        ::free(buf);
-        return static_cast<char*>(nullptr);
-      }, 
-      0, out, err
-    ))
-      ;
+    auto const first_line = history::append_lines(file.text, file.size);
+
+    source_reader reader{file.text, file.size};
+    form_span form;
+
+    while (reader.next(form)) {
+      out.write(file.text + form.begin, form.end - form.begin) << "\n";
+
+      if (options.collect) {
+        collect_cycles_if_grown();
+      }
+
+      evaluate(
+        parse(file.text, form.begin, form.end, first_line + form.first_line),
+        0,
+        form.first_line != form.last_line,
+        first_line + form.first_line,
+        out, err);
+      out << "\n\n";
+    }
+  }
+
+  namespace {
+
+    // .predef.yl is snapshotted to .predef.img
+    string_representation snapshot_path(string_representation const& predef) noexcept {
+      auto const ext = make_string(".yl");
+      auto const stem = predef.size() > ext.size()
+          && predef.compare(predef.size() - ext.size(), ext.size(), ext) == 0
+        ? predef.substr(0, predef.size() - ext.size())
+        : predef;
+      return concat(stem, ".img");
+    }
+
+    string_representation run_predef(source_file const& file) noexcept {
+      ::std::stringstream ss;
+      ::std::ostream dev_null{nullptr};
+      handle_file(file, dev_null, ss);
+
+      if (ss.str().size()) {
+        ::std::cout << ss.str() << "\n";
+      }
+
+      return make_string(
+        ss.str().size()
+          ? "errors in predef"
+          : ""
+      );
+    }
+
   }
 
   string_representation load_predef(      
     string_representation const& predef
     ) noexcept {
-    ::std::ifstream in{predef.c_str()};
-    if (!in.is_open()) {
+    auto const file = open_source(predef.c_str());
+    if (!file) {
+      return make_string("could not open predef file");
+    }
+
+    // positions in the snapshot point into the lines the predef would
+    // have taken up in the history
+    auto const first_line = history::size();
+    auto const snapshot = load_globals(
+      snapshot_path(predef).c_str(),
+      image_key(file->text, file->size),
+      first_line
+    );
+    if (snapshot) {
+      history::append_lines(file->text, file->size);
+      return make_string();
+    }
+
+    return run_predef(*file);
+  }
+
+  string_representation snapshot_predef(
+    string_representation const& predef
+  ) noexcept {
+    auto const file = open_source(predef.c_str());
+    if (!file) {
       return make_string("could not open predef file");
     }
-    ::std::stringstream ss;
-    ::std::ostream dev_null{nullptr};
-    handle_file(::std::move(in), dev_null, ss);
 
-    if (ss.str().size()) {
-      ::std::cout << ss.str() << "\n";
+    auto const first_line = history::size();
+    if (auto const result = run_predef(*file); !result.empty()) {
+      return result;
     }
 
-    return make_string(
-      ss.str().size()
-        ? "errors in predef"
-        : ""
+    auto const saved = save_globals(
+      snapshot_path(predef).c_str(),
+      image_key(file->text, file->size),
+      first_line
     );
+    return saved ? make_string() : saved.error().error_message;
   }
 
 }
@@ -0,0 +1,883 @@
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+
+#include <yl/arguments.hpp>
+#include <yl/fold.hpp>
+#include <yl/vm.hpp>
+
+#include "builtins.hpp"
+
+// labels as values, falls back to a switch on other compilers
+#if defined(__GNUC__) || defined(__clang__)
+#define YL_COMPUTED_GOTO
+#endif
+
+namespace yl::vm {
+
+  enum opcode : ::std::uint8_t {
+    op_const,         // a <- constant b
+    op_nil,           // a <- () positioned at call site b
+    op_global,        // a <- symbol b, looked up through the whole chain
+    op_local,         // a <- symbol b, found at depth c >> 24 and slot c
+    op_macro,         // a holds the head of call site b, jumps to c when that
+                      // completes the call, ie. for macros and lone values
+    op_call,          // a <- a(a + 1, ..., a + b) for call site c
+    op_tail_call,     // same as op_call, compiled functions replace the frame
+    op_guard,         // jumps to c unless symbol a still resolves to builtin b
+    op_jump,          // jumps to c
+    op_branch,        // jumps to c if a is 0, b is the condition for errors
+    // a <- builtin(a + 1, ..., a + b) for call site c, builtin is c + 1
+    op_add,
+    op_sub,
+    op_less,
+    op_greater,
+    op_less_eq,
+    op_greater_eq,
+    op_equal,
+    op_head,
+    op_tail,
+    op_len,
+    op_cons,
+    op_return,        // returns a
+    op_count
+  };
+
+  struct instruction {
+    ::std::uint32_t op : 8;
+    ::std::uint32_t a : 24;
+    ::std::uint32_t b;
+    ::std::uint32_t c;
+  };
+
+  struct prototype {
+    seq_representation<instruction> code = make_seq<instruction>();
+    seq_representation<unit_ptr> constants = make_seq<unit_ptr>();
+    ::std::uint32_t registers = 1;
+  };
+
+  using prototype_ptr = ::std::shared_ptr<prototype const>;
+
+  struct closure {
+    prototype_ptr proto;
+    signature sig;
+    unit_ptr body;
+    env_node_ptr env;
+    function_kind kind;
+    env_ptr bound;
+  };
+
+  namespace {
+
+    using builtin_ptr = function::builtin_type;
+
+    auto constexpr variadic = ::std::numeric_limits<::std::size_t>::max();
+
+    struct hot_builtin {
+      char const* name;
+      opcode op;
+      builtin_ptr impl;
+      ::std::size_t min_args;
+      ::std::size_t max_args;
+    };
+
+    // if and do have no opcodes of their own, they are compiled into
+    // branches and sequences
+    hot_builtin const hot_builtins[] = {
+      {"+",    op_add,        add_m,              1, variadic},
+      {"-",    op_sub,        sub_m,              1, variadic},
+      {"<",    op_less,       less_than_m,        2, 2},
+      {">",    op_greater,    greater_than_m,     2, 2},
+      {"<=",   op_less_eq,    less_or_equal_m,    2, 2},
+      {">=",   op_greater_eq, greater_or_equal_m, 2, 2},
+      {"==",   op_equal,      equal_m,            2, 2},
+      {"head", op_head,       head_m,             1, 1},
+      {"tail", op_tail,       tail_m,             1, 1},
+      {"len",  op_len,        len_m,              1, 1},
+      {"cons", op_cons,       cons_m,             2, 2},
+      {"if",   op_branch,     if_m,               2, 3},
+      {"do",   op_jump,       do_m,               1, variadic},
+    };
+
+    auto constexpr hot_count = sizeof(hot_builtins) / sizeof(hot_builtin);
+
+    symbol_id hot_id(::std::size_t const idx) noexcept {
+      static auto const ids = [] {
+        ::std::array<symbol_id, hot_count> ret;
+        for (::std::size_t i = 0; i < hot_count; ++i) {
+          ret[i] = intern(make_string(hot_builtins[i].name));
+        }
+        return ret;
+      }();
+      return ids[idx];
+    }
+
+    bool is_symbol(unit_ptr const& u) noexcept {
+      return is_string(u->expr) && !as_string(u->expr).raw;
+    }
+
+    // layouts of the frames whose slots code can address, innermost first
+    seq_representation<frame_layout const*> scope_of(
+      frame_layout const* innermost, env_node_ptr const& env
+    ) noexcept {
+      auto scope = make_seq<frame_layout const*>();
+      if (!innermost) {
+        return scope;
+      }
+      scope.push_back(innermost);
+      for (auto node = env.get(); node && node->curr->layout;
+           node = node->prev.get()) {
+        scope.push_back(node->curr->layout.get());
+      }
+      return scope;
+    }
+
+    class compiler {
+     public:
+      compiler(
+        prototype& proto,
+        seq_representation<frame_layout const*> scope
+      ) noexcept
+        : proto(proto), scope(::std::move(scope)) {}
+
+      // calls in tail position replace the frame of the caller
+      void compile(
+        unit_ptr const& u, ::std::uint32_t const dst, bool const tail = false
+      ) noexcept {
+        proto.registers = ::std::max(proto.registers, dst + 1);
+
+        if (is_list(u->expr)) {
+          if (as_list(u->expr).empty()) {
+            emit(op_const, dst, constant(u));
+          } else if (auto const known = options.fold ? fold(u) : ::std::nullopt) {
+            compile_folded(u, *known, dst, tail);
+          } else {
+            compile_call(u, dst, tail);
+          }
+        } else if (is_symbol(u)) {
+          compile_symbol(u, dst);
+        } else {
+          emit(op_const, dst, constant(u));
+        }
+      }
+
+      void finish(::std::uint32_t const result) noexcept {
+        emit(op_return, result);
+      }
+
+     private:
+      prototype& proto;
+      seq_representation<frame_layout const*> scope;
+
+      ::std::uint32_t constant(unit_ptr const& u) noexcept {
+        proto.constants.push_back(u);
+        return proto.constants.size() - 1;
+      }
+
+      ::std::size_t emit(
+        opcode const op,
+        ::std::uint32_t const a = 0,
+        ::std::uint32_t const b = 0,
+        ::std::uint32_t const c = 0
+      ) noexcept {
+        proto.code.push_back(instruction{op, a, b, c});
+        return proto.code.size() - 1;
+      }
+
+      // points the jump at idx to the next instruction
+      void patch(::std::size_t const idx) noexcept {
+        proto.code[idx].c = proto.code.size();
+      }
+
+      bool resolve(
+        symbol_id const id, ::std::uint32_t& depth, ::std::uint32_t& slot
+      ) const noexcept {
+        for (depth = 0; depth < scope.size(); ++depth) {
+          auto const& names = scope[depth]->names;
+          auto const iter = ::std::find(names.begin(), names.end(), id);
+          if (iter != names.end()) {
+            slot = iter - names.begin();
+            return true;
+          }
+        }
+        return false;
+      }
+
+      void compile_symbol(unit_ptr const& u, ::std::uint32_t const dst) noexcept {
+        auto const k = constant(u);
+        ::std::uint32_t depth, slot;
+
+        if (resolve(symbol_of(as_string(u->expr)), depth, slot)
+            && depth < (1u << 8) && slot < (1u << 24)) {
+          emit(op_local, dst, k, depth << 24 | slot);
+        } else {
+          emit(op_global, dst, k);
+        }
+      }
+
+      // builtin the call site would reach if nothing rebinds its name
+      hot_builtin const* find_hot(list const& ls, unit_ptr& builtin) const noexcept {
+        if (!is_symbol(ls.front())) {
+          return nullptr;
+        }
+
+        auto const id = symbol_of(as_string(ls.front()->expr));
+        ::std::uint32_t depth, slot;
+        if (resolve(id, depth, slot)) {
+          return nullptr;
+        }
+
+        auto static const comma = intern(make_string(","));
+        for (auto const& arg : ls) {
+          if (is_symbol(arg) && symbol_of(as_string(arg->expr)) == comma) {
+            return nullptr;
+          }
+        }
+
+        for (::std::size_t i = 0; i < hot_count; ++i) {
+          auto const& hot = hot_builtins[i];
+          if (hot_id(i) != id
+              || ls.size() - 1 < hot.min_args || ls.size() - 1 > hot.max_args) {
+            continue;
+          }
+
+          auto const* bound = global_environment()->curr->find(id);
+          if (!bound || !is_function((*bound)->expr)) {
+            return nullptr;
+          }
+          if (as_function((*bound)->expr).builtin != hot.impl) {
+            return nullptr;
+          }
+
+          builtin = *bound;
+          return &hot;
+        }
+
+        return nullptr;
+      }
+
+      // guards that jump to the next instruction to be patched once any of
+      // the folded heads is rebound
+      seq_representation<::std::size_t> emit_guards(folded const& known) noexcept {
+        auto guards = make_seq<::std::size_t>();
+        for (auto const& [head, builtin] : known.guards) {
+          guards.push_back(emit(op_guard, constant(head), constant(builtin)));
+        }
+        return guards;
+      }
+
+      void compile_folded(
+        unit_ptr const& u,
+        folded const& known,
+        ::std::uint32_t const dst,
+        bool const tail
+      ) noexcept {
+        auto const guards = emit_guards(known);
+        emit(op_const, dst, constant(known.value));
+        auto const done = emit(op_jump);
+        for (auto const guard : guards) {
+          patch(guard);
+        }
+        compile_call(u, dst, tail);
+        patch(done);
+      }
+
+      void compile_call(
+        unit_ptr const& u, ::std::uint32_t const dst, bool const tail
+      ) noexcept {
+        auto const& ls = as_list(u->expr);
+        ::std::size_t done = 0;
+
+        unit_ptr builtin;
+        if (auto const* hot = find_hot(ls, builtin)) {
+          auto const site = constant(u);
+          auto const impl = constant(builtin);
+          auto const guard = emit(op_guard, constant(ls.front()), impl);
+          auto const condition = hot->op == op_branch && options.fold
+            ? fold_condition(ls[1])
+            : ::std::nullopt;
+          auto known = make_seq<::std::size_t>();
+
+          if (condition) {
+            // only the live branch is compiled, the generic call below
+            // takes over once the condition stops folding
+            known = emit_guards(*condition);
+            if (as_numeric(condition->value->expr)) {
+              compile(ls[2], dst, tail);
+            } else if (ls.size() == 4) {
+              compile(ls[3], dst, tail);
+            } else {
+              emit(op_nil, dst, site);
+            }
+          } else if (hot->op == op_branch) {
+            compile(ls[1], dst);
+            auto const branch = emit(op_branch, dst, constant(ls[1]));
+            compile(ls[2], dst, tail);
+            auto const end = emit(op_jump);
+            patch(branch);
+            if (ls.size() == 4) {
+              compile(ls[3], dst, tail);
+            } else {
+              emit(op_nil, dst, site);
+            }
+            patch(end);
+          } else if (hot->op == op_jump) {
+            for (::std::size_t i = 1; i < ls.size(); ++i) {
+              compile(ls[i], dst, tail && i == ls.size() - 1);
+            }
+          } else {
+            for (::std::size_t i = 1; i < ls.size(); ++i) {
+              compile(ls[i], dst + i);
+            }
+            emit(hot->op, dst, ls.size() - 1, site);
+          }
+
+          done = emit(op_jump);
+          patch(guard);
+          for (auto const idx : known) {
+            patch(idx);
+          }
+        }
+
+        auto const site = constant(u);
+        compile(ls.front(), dst);
+
+        auto const macro = emit(op_macro, dst, site);
+        for (::std::size_t i = 1; i < ls.size(); ++i) {
+          compile(ls[i], dst + i);
+        }
+        emit(tail ? op_tail_call : op_call, dst, ls.size() - 1, site);
+        patch(macro);
+
+        if (done) {
+          patch(done);
+        }
+      }
+    };
+
+    prototype_ptr compile(
+      unit_ptr const& body,
+      seq_representation<frame_layout const*> scope
+    ) noexcept {
+      prototype proto;
+      compiler c{proto, ::std::move(scope)};
+      c.compile(body, 0, true);
+      c.finish(0);
+      return make_shared(::std::move(proto));
+    }
+
+    struct frame {
+      prototype_ptr proto;
+      instruction const* pc;
+      env_node_ptr env;
+      // registers of the frame live on the argument stack, so builtins are
+      // called with spans of them, saved is where they start
+      unit_ptr* regs;
+      argument_stack::mark saved;
+      // register of the caller that wants the result
+      unit_ptr* result;
+    };
+
+    // active frames, calls between compiled functions push a frame
+    // instead of recursing
+    struct machine {
+      seq_representation<frame> frames = make_seq<frame>();
+    };
+
+    machine& state() noexcept {
+      static machine m;
+      return m;
+    }
+
+    // args are the evaluated arguments of call site site
+    result_type call_builtin(
+      unit_ptr const& builtin,
+      unit_ptr const* args,
+      ::std::size_t const count,
+      unit_ptr const& site,
+      env_node_ptr const& env
+    ) noexcept {
+      return invoke(
+        builtin, argument_span{args, count, &as_list(site->expr)}, site->pos, env
+      );
+    }
+
+    template<typename Op>
+    bool fold_numeric(
+      unit_ptr const* args, ::std::size_t const count, numeric& result, Op op
+    ) noexcept {
+      for (::std::size_t i = 0; i < count; ++i) {
+        if (!is_numeric(args[i]->expr)) {
+          return false;
+        }
+        result = i ? op(result, as_numeric(args[i]->expr)) : as_numeric(args[i]->expr);
+      }
+      return true;
+    }
+
+    template<typename Op>
+    bool compare_numeric(unit_ptr const* args, numeric& result, Op op) noexcept {
+      if (!is_numeric(args[0]->expr) || !is_numeric(args[1]->expr)) {
+        return false;
+      }
+      result = op(as_numeric(args[0]->expr), as_numeric(args[1]->expr));
+      return true;
+    }
+
+    function function_for(
+      ::std::shared_ptr<closure const> const& cl,
+      string_representation const& description,
+      bool const macro
+    ) noexcept;
+
+    unit_ptr partial(
+      closure const& cl,
+      ::std::size_t const count,
+      env_ptr const& frame,
+      env_node_ptr const& env
+    ) noexcept {
+      return ::yl::make_shared<unit>(cl.body->pos, function_for(
+        make_shared(closure{
+          cl.proto, partial_signature(cl.sig, count), cl.body, env, cl.kind, frame
+        }),
+        make_string("User defined partially evaluated function."),
+        false
+      ));
+    }
+
+    result_type execute(
+      prototype_ptr const& proto, env_node_ptr env, position const& pos
+    ) noexcept {
+      // macros and builtins that call back into the vm nest natively
+      if (native_stack_exhausted()) {
+        FAIL_WITH("Maximum recursion depth exceeded.", pos);
+      }
+
+      auto& m = state();
+      auto& stack = arguments();
+      auto const floor = m.frames.size();
+      auto const entry = stack.position();
+
+      auto regs = stack.push(proto->registers);
+      m.frames.push_back(frame{proto, nullptr, env, regs, entry, nullptr});
+
+      auto code = proto->code.data();
+      auto k = proto->constants.data();
+      auto pc = code;
+
+#define REG(i) regs[i]
+
+#define VM_FAIL(msg, pos) \
+      { \
+        auto err = error_info{make_string(msg), pos}; \
+        m.frames.resize(floor); \
+        stack.pop(entry); \
+        return fail(::std::move(err)); \
+      }
+
+#define VM_RETURN_IF_ERROR(either) \
+      if (!(either)) { \
+        m.frames.resize(floor); \
+        stack.pop(entry); \
+        return fail(either.error()); \
+      }
+
+#ifdef YL_COMPUTED_GOTO
+      static void* const labels[op_count] = {
+        &&l_op_const, &&l_op_nil, &&l_op_global, &&l_op_local, &&l_op_macro,
+        &&l_op_call, &&l_op_tail_call, &&l_op_guard, &&l_op_jump, &&l_op_branch, &&l_op_add, &&l_op_sub,
+        &&l_op_less, &&l_op_greater, &&l_op_less_eq, &&l_op_greater_eq,
+        &&l_op_equal, &&l_op_head, &&l_op_tail, &&l_op_len, &&l_op_cons,
+        &&l_op_return
+      };
+#define VM_CASE(name) l_##name:
+#define VM_DISPATCH() goto *labels[pc->op]
+#else
+#define VM_CASE(name) case name:
+#define VM_DISPATCH() goto dispatch
+#endif
+
+#define VM_NEXT() \
+      { \
+        ++pc; \
+        VM_DISPATCH(); \
+      }
+
+#define VM_JUMP(target) \
+      { \
+        pc = code + (target); \
+        VM_DISPATCH(); \
+      }
+
+#define VM_SET_OR_FAIL(reg, either) \
+      { \
+        auto const result__ = either; \
+        VM_RETURN_IF_ERROR(result__); \
+        REG(reg) = result__.value(); \
+      }
+
+#ifndef YL_COMPUTED_GOTO
+     dispatch:
+      switch (pc->op) {
+#else
+      VM_DISPATCH();
+      {
+#endif
+
+      VM_CASE(op_const) {
+        REG(pc->a) = k[pc->b];
+        VM_NEXT();
+      }
+
+      VM_CASE(op_nil) {
+        REG(pc->a) = make_nil();
+        VM_NEXT();
+      }
+
+      VM_CASE(op_global)
+      VM_CASE(op_local) {
+        auto const& sym = k[pc->b];
+        unit_ptr const* value = nullptr;
+
+        if (pc->op == op_local) {
+          auto const depth = pc->c >> 24;
+          auto const* node = env.get();
+          ::std::uint32_t d = 0;
+          for (; d < depth && node->curr->dynamic.empty(); ++d) {
+            node = node->prev.get();
+          }
+          if (d == depth) {
+            if (auto const& slot = node->curr->slots[pc->c & 0xffffff]) {
+              value = &slot;
+            }
+          }
+        }
+
+        if (!value && !(value = lookup(as_string(sym->expr), env))) {
+          VM_FAIL(
+            concat("Symbol ", as_string(sym->expr).str, " is undefined."),
+            sym->pos
+          );
+        }
+
+        REG(pc->a) = *value;
+        VM_NEXT();
+      }
+
+      VM_CASE(op_macro) {
+        auto const& head = REG(pc->a);
+        auto const& site = k[pc->b];
+        auto const& ls = as_list(site->expr);
+
+        if (!is_function(head->expr)) {
+          if (ls.size() == 1) {
+            VM_JUMP(pc->c);
+          }
+          VM_FAIL(
+            concat(
+              "Expected a builtin or user defined function, got ",
+              type_of(head->expr),
+              " with value ",
+              head->expr,
+              ", complete expression: ",
+              site->expr,
+              "."
+            ),
+            reference_position(ls.front(), head)
+          );
+        }
+
+        if (!as_function(head->expr).macro) {
+          VM_NEXT();
+        }
+
+        {
+          auto const mark = stack.position();
+          auto* const args = stack.push(ls.size() - 1);
+          ::std::copy(ls.begin() + 1, ls.end(), args);
+          auto const kept = force_marked(args, ls.size() - 1, env);
+          VM_RETURN_IF_ERROR(kept);
+
+          auto const callee = head;
+          auto result =
+            invoke(callee, argument_span{args, kept.value()}, site->pos, env);
+          stack.pop(mark);
+          VM_SET_OR_FAIL(pc->a, ::std::move(result));
+        }
+        VM_JUMP(pc->c);
+      }
+
+      VM_CASE(op_call)
+      VM_CASE(op_tail_call) {
+        // computed gotos do not run destructors, the handles this call
+        // holds are released by leaving the block with a plain goto
+        {
+          auto const callee = REG(pc->a);
+          auto const& fn = as_function(callee->expr);
+          auto const& site = k[pc->c];
+          auto const count = pc->b;
+
+          if (!fn.compiled) {
+            VM_SET_OR_FAIL(
+              pc->a, call_builtin(callee, &REG(pc->a + 1), count, site, env)
+            );
+            goto call_returned;
+          }
+
+          auto const& cl = *fn.compiled;
+          auto const frame_env =
+            bind_arguments(cl.sig, &REG(pc->a + 1), count, site->pos, cl.bound);
+          VM_RETURN_IF_ERROR(frame_env);
+
+          auto const outer = cl.kind == function_kind::syntax ? env : cl.env;
+
+          if (is_partial(cl.sig, count)) {
+            REG(pc->a) = partial(cl, count, frame_env.value(), outer);
+            goto call_returned;
+          }
+
+          if (pc->op == op_tail_call) {
+            auto& current = m.frames.back();
+            stack.pop(current.saved);
+            regs = stack.push(cl.proto->registers);
+            env = make_shared(env_node{frame_env.value(), outer});
+            current.proto = cl.proto;
+            current.env = env;
+            current.regs = regs;
+          } else {
+            if (m.frames.size() >= options.max_depth) {
+              VM_FAIL(
+                concat("Maximum recursion depth of ", options.max_depth, " exceeded."),
+                site->pos
+              );
+            }
+
+            m.frames.back().pc = pc + 1;
+            auto* const result = &REG(pc->a);
+
+            auto const saved = stack.position();
+            regs = stack.push(cl.proto->registers);
+            env = make_shared(env_node{frame_env.value(), outer});
+            m.frames.push_back(frame{cl.proto, nullptr, env, regs, saved, result});
+          }
+
+          code = cl.proto->code.data();
+          k = cl.proto->constants.data();
+          goto call_entered;
+        }
+
+       call_returned:
+        VM_NEXT();
+
+       call_entered:
+        VM_JUMP(0);
+      }
+
+      VM_CASE(op_guard) {
+        auto const* value = lookup(as_string(k[pc->a]->expr), env);
+        if (!value || value->get() != k[pc->b].get()) {
+          VM_JUMP(pc->c);
+        }
+        VM_NEXT();
+      }
+
+      VM_CASE(op_jump) {
+        VM_JUMP(pc->c);
+      }
+
+      VM_CASE(op_branch) {
+        auto const& condition = REG(pc->a);
+        if (!is_numeric(condition->expr)) {
+          VM_FAIL("Expected a numeric value.", k[pc->b]->pos);
+        }
+        if (!as_numeric(condition->expr)) {
+          VM_JUMP(pc->c);
+        }
+        VM_NEXT();
+      }
+
+#define VM_FALLBACK() \
+      { \
+        VM_SET_OR_FAIL( \
+          pc->a, \
+          call_builtin(k[pc->c + 1], &REG(pc->a + 1), pc->b, k[pc->c], env) \
+        ); \
+        VM_NEXT(); \
+      }
+
+#define VM_NUMERIC(name, check) \
+      VM_CASE(name) { \
+        numeric result = 0; \
+        if (!(check)) VM_FALLBACK(); \
+        REG(pc->a) = make_numeric(k[pc->c]->pos, result); \
+        VM_NEXT(); \
+      }
+
+      VM_NUMERIC(op_add, fold_numeric(&REG(pc->a + 1), pc->b, result, ::std::plus<>{}));
+      VM_NUMERIC(op_sub, fold_numeric(&REG(pc->a + 1), pc->b, result, ::std::minus<>{}));
+      VM_NUMERIC(op_less, compare_numeric(&REG(pc->a + 1), result, ::std::less<>{}));
+      VM_NUMERIC(op_greater, compare_numeric(&REG(pc->a + 1), result, ::std::greater<>{}));
+      VM_NUMERIC(op_less_eq, compare_numeric(&REG(pc->a + 1), result, ::std::less_equal<>{}));
+      VM_NUMERIC(op_greater_eq, compare_numeric(&REG(pc->a + 1), result, ::std::greater_equal<>{}));
+
+      VM_CASE(op_equal) {
+        REG(pc->a) = make_numeric(
+          k[pc->c]->pos, numeric{REG(pc->a + 1) == REG(pc->a + 2)}
+        );
+        VM_NEXT();
+      }
+
+      VM_CASE(op_head) {
+        auto const& arg = REG(pc->a + 1);
+        if (!is_list(arg->expr)) VM_FALLBACK();
+        auto const& ls = as_list(arg->expr);
+        REG(pc->a) = ls.empty() ? make_nil() : ls.front();
+        VM_NEXT();
+      }
+
+      VM_CASE(op_tail) {
+        auto const& arg = REG(pc->a + 1);
+        if (!is_list(arg->expr)) VM_FALLBACK();
+        REG(pc->a) = make_value(arg->pos, reuse<list>(arg).drop(1));
+        VM_NEXT();
+      }
+
+      VM_CASE(op_len) {
+        auto const& arg = REG(pc->a + 1);
+        if (!is_list(arg->expr)) VM_FALLBACK();
+        REG(pc->a) = make_numeric(
+          k[pc->c]->pos, numeric(as_list(arg->expr).size())
+        );
+        VM_NEXT();
+      }
+
+      VM_CASE(op_cons) {
+        if (!is_list(REG(pc->a + 2)->expr)) VM_FALLBACK();
+        REG(pc->a) = ::yl::make_shared<unit>(
+          k[pc->c]->pos, make_list().push_back(REG(pc->a + 1)) + reuse<list>(REG(pc->a + 2))
+        );
+        VM_NEXT();
+      }
+
+      VM_CASE(op_return) {
+        auto result = ::std::move(REG(pc->a));
+        auto const saved = m.frames.back().saved;
+        auto* const target = m.frames.back().result;
+        m.frames.pop_back();
+        stack.pop(saved);
+
+        if (m.frames.size() == floor) {
+          return succeed(::std::move(result));
+        }
+
+        *target = ::std::move(result);
+
+        auto const& caller = m.frames.back();
+        regs = caller.regs;
+        env = caller.env;
+        code = caller.proto->code.data();
+        k = caller.proto->constants.data();
+        pc = caller.pc;
+        VM_DISPATCH();
+      }
+
+#ifndef YL_COMPUTED_GOTO
+        default:
+          terminate_with("Invalid opcode.");
+#endif
+      }
+
+#undef VM_NUMERIC
+#undef VM_FALLBACK
+#undef VM_SET_OR_FAIL
+#undef VM_JUMP
+#undef VM_NEXT
+#undef VM_DISPATCH
+#undef VM_CASE
+#undef VM_RETURN_IF_ERROR
+#undef VM_FAIL
+#undef REG
+    }
+
+    result_type call(
+      closure const& cl,
+      unit_ptr const* args,
+      ::std::size_t const count,
+      position const& pos,
+      env_node_ptr const& caller
+    ) noexcept {
+      auto const frame = bind_arguments(cl.sig, args, count, pos, cl.bound);
+      RETURN_IF_ERROR(frame);
+
+      auto const& env = cl.kind == function_kind::syntax ? caller : cl.env;
+
+      if (is_partial(cl.sig, count)) {
+        return succeed(partial(cl, count, frame.value(), env));
+      }
+
+      return execute(cl.proto, make_shared(env_node{frame.value(), env}), pos);
+    }
+
+    function function_for(
+      ::std::shared_ptr<closure const> const& cl,
+      string_representation const& description,
+      bool const macro
+    ) noexcept {
+      return function{
+        .description = description,
+        .func = [cl](unit_ptr const& u, env_node_ptr const& caller) -> result_type {
+          auto const& arguments = as_list(u->expr);
+          argument_window values{arguments.size() - 1};
+          ::std::copy(arguments.begin() + 1, arguments.end(), values.data());
+          return call(*cl, values.data(), arguments.size() - 1, u->pos, caller);
+        },
+        .macro = macro,
+        .compiled = cl
+      };
+    }
+
+  }
+
+  function make_function(
+    signature const& sig,
+    unit_ptr const& body,
+    env_node_ptr const& env,
+    function_kind const fk,
+    string_representation const& description,
+    env_ptr const& bound
+  ) noexcept {
+    // call sites of syntax macros decide what encloses their frames
+    auto const proto = compile(
+      body,
+      scope_of(
+        sig.layout.get(),
+        fk == function_kind::syntax ? env_node_ptr{} : env
+      )
+    );
+
+    return function_for(
+      make_shared(closure{proto, sig, body, env, fk, bound}),
+      description,
+      fk != function_kind::regular
+    );
+  }
+
+  function_parts parts_of(closure const& cl) noexcept {
+    return function_parts{cl.sig, cl.body, cl.env, cl.kind, cl.bound};
+  }
+
+  void trace(closure const& cl, tracer& visit) noexcept {
+    ::yl::trace(cl.sig.arglist, visit);
+    visit(cl.body);
+    visit(cl.env);
+    visit(cl.bound);
+  }
+
+  result_type run(unit_ptr const& form, env_node_ptr const& node) noexcept {
+    return execute(
+      compile(form, scope_of(node->curr->layout.get(), node->prev)), node, form->pos
+    );
+  }
+
+}